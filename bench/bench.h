@@ -0,0 +1,57 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <QElapsedTimer>
+
+#include <vector>
+
+// command line options, see main.cpp
+struct BenchOptions
+{
+    qint64 minTime{200};       // ms per measurement
+    size_t maxSize{100000000}; // largest n
+    const char *filter{nullptr};
+};
+extern BenchOptions benchOptions;
+
+// Time f() repeatedly for at least minTime ms, return ns per call
+template <class F>
+double timeit(F f, qint64 minTime = benchOptions.minTime)
+{
+    f(); // warm up
+
+    QElapsedTimer t;
+    qint64 reps = 0;
+    t.start();
+    do
+    {
+        f();
+        ++reps;
+    } while (t.elapsed() < minTime);
+    return 1. * t.nsecsElapsed() / reps;
+}
+
+// keeps results alive so that the benchmarked code is not optimized out
+template <class T>
+inline void doNotOptimize(const T &v)
+{
+    static volatile T sink;
+    sink = v;
+}
+
+// n = 1e3, 1e4, ... up to benchOptions.maxSize
+std::vector<size_t> benchSizes();
+
+// true if the benchmark group name passes the filter
+bool benchEnabled(const char *name);
+
+// record a result: ns per call of name at size n, with n elements
+// processed per call (0 if the cost does not scale with n)
+void report(const char *name, size_t n, double ns, size_t elements);
+
+void benchMinMax();
+void benchAdaptors();
+void benchImage();
+void benchLineSpec();
+
+#endif // BENCH_H
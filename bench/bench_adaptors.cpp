@@ -0,0 +1,161 @@
+#include "bench.h"
+
+#include <QMatPlotWidget>
+
+#include <cmath>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+// construction, sample() and boundingRect() of a series adaptor;
+// make() returns a new adaptor over the data
+template <class Make>
+static void benchSeries(const std::string &name, size_t n, Make make)
+{
+    if (!benchEnabled(name.c_str()))
+        return;
+
+    double t = timeit([&]() { delete make(); });
+    report((name + "/construct").c_str(), n, t, n);
+
+    std::unique_ptr<AbstractDataSeriesAdaptor> a(make());
+    const int m = a->size();
+    t = timeit([&]() {
+        double s = 0.;
+        for (int i = 0; i < m; ++i)
+        {
+            const QPointF p = a->sample(i);
+            s += p.x() + p.y();
+        }
+        doNotOptimize(s);
+    });
+    report((name + "/sample").c_str(), n, t, size_t(m));
+
+    // full scan, as after a data change
+    t = timeit([&]() {
+        a->invalidate();
+        doNotOptimize(a->boundingRect().height());
+    });
+    report((name + "/boundingRect").c_str(), n, t, n);
+
+    // the same on one thread
+    const int threshold = QMatPlotWidget::parallelThreshold();
+    QMatPlotWidget::setParallelThreshold(0);
+    t = timeit([&]() {
+        a->invalidate();
+        doNotOptimize(a->boundingRect().height());
+    });
+    QMatPlotWidget::setParallelThreshold(threshold);
+    report((name + "/boundingRect_serial").c_str(), n, t, n);
+
+    t = timeit([&]() { doNotOptimize(a->boundingRect().height()); });
+    report((name + "/boundingRect_cached").c_str(), n, t, 0);
+}
+
+// as benchSeries, plus the intervals and their extents
+template <class Make>
+static void benchErrorBars(const std::string &name, size_t n, Make make)
+{
+    if (!benchEnabled(name.c_str()))
+        return;
+
+    double t = timeit([&]() { delete make(); });
+    report((name + "/construct").c_str(), n, t, n);
+
+    std::unique_ptr<AbstractErrorBarAdaptor> a(make());
+    const int m = a->size();
+    t = timeit([&]() {
+        double s = 0.;
+        for (int i = 0; i < m; ++i)
+        {
+            const QPointF p = a->sample(i);
+            s += p.x() + p.y();
+        }
+        doNotOptimize(s);
+    });
+    report((name + "/sample").c_str(), n, t, size_t(m));
+
+    t = timeit([&]() {
+        double s = 0.;
+        for (int i = 0; i < m; ++i)
+        {
+            const QPointF p = a->interval(i);
+            s += p.x() + p.y();
+        }
+        doNotOptimize(s);
+    });
+    report((name + "/interval").c_str(), n, t, size_t(m));
+
+    t = timeit([&]() {
+        a->invalidate();
+        doNotOptimize(a->boundingRect().height());
+    });
+    report((name + "/boundingRect").c_str(), n, t, n);
+
+    t = timeit([&]() {
+        a->invalidate();
+        doNotOptimize(a->errorBoundingRect().height());
+    });
+    report((name + "/errorBoundingRect").c_str(), n, t, n);
+}
+
+// the adaptors over container type V_, which may copy the data
+template <class V_>
+static void benchContainer(const char *type, const V_ &x, const V_ &y, const V_ &e)
+{
+    const size_t n = y.size();
+    const std::string suffix = std::string("<") + type + ">";
+
+    benchSeries("DataSeriesAdaptor" + suffix, n, [&]() {
+        return new DataSeriesAdaptor<V_>(x, y);
+    });
+    benchSeries("StairsAdaptor" + suffix, n, [&]() {
+        return new StairsAdaptor<V_>(x, y);
+    });
+    benchErrorBars("ErrorBarAdaptor" + suffix + "/scalar", n, [&]() {
+        return new ErrorBarAdaptor<V_>(x, y, 0.5);
+    });
+    benchErrorBars("ErrorBarAdaptor" + suffix + "/vector", n, [&]() {
+        return new ErrorBarAdaptor<V_>(x, y, e);
+    });
+}
+
+void benchAdaptors()
+{
+    std::mt19937 gen(42);
+    std::normal_distribution<double> dist;
+
+    for (size_t n : benchSizes())
+    {
+        const int m = static_cast<int>(n);
+        QVector<double> x(m), y(m), e(m);
+        for (size_t i = 0; i < n; ++i)
+        {
+            x[int(i)] = double(i);
+            y[int(i)] = dist(gen);
+            e[int(i)] = 0.1 * std::abs(dist(gen));
+        }
+        benchContainer("QVector", x, y, e);
+
+        // ADC counts, a quarter of the memory of doubles, plotted in volts
+        QVector<qint16> counts(m);
+        for (int i = 0; i < m; ++i)
+            counts[i] = qint16(1000. * y[i]);
+        benchSeries("DataSeriesAdaptor<QVector<qint16>>/scaled", n, [&]() {
+            DataSeriesAdaptor<QVector<qint16>> *a = new DataSeriesAdaptor<QVector<qint16>>(counts);
+            a->yScale = SampleScale{10. / 32768, 0.};
+            return a;
+        });
+
+        // std::vector is copied by the adaptors: skip the largest size,
+        // to bound the memory used
+        if (n * 10 <= benchOptions.maxSize)
+        {
+            const std::vector<double> sx(x.begin(), x.end());
+            const std::vector<double> sy(y.begin(), y.end());
+            const std::vector<double> se(e.begin(), e.end());
+            benchContainer("std::vector", sx, sy, se);
+        }
+    }
+}
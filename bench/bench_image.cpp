@@ -0,0 +1,151 @@
+#include "bench.h"
+
+#include "qwtraster.h"
+
+#include <QMatPlotWidget>
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+static const int Columns = 1000;
+
+static void benchImageHelper(const QVector<double> &z)
+{
+    const size_t n = z.size();
+    ImageHelper img(new ImageAdaptor<QVector<double>>(z, Columns), true);
+    const double t = timeit([&]() {
+        img.init();
+        doNotOptimize(img.version);
+    });
+    report("ImageHelper/init", n, t, n);
+}
+
+// linear colorize() with the indexes in 16.16 fixed point, saturated
+// in double so that the conversion cannot overflow, for comparison
+static void colorizeQ16(const QVector<QRgb> &colors,
+                        const QwtInterval &range,
+                        const double *v,
+                        int n,
+                        QRgb *out)
+{
+    const int invalid = colors.size();
+    QVector<QRgb> lut = colors;
+    lut << 0u;
+    const double gain = 65536. * invalid / range.width();
+    const double offset = -range.minValue() * gain;
+    const double lim = 65536. * invalid;
+    const qint32 top = (invalid - 1) << 16;
+    qint32 q[256];
+    for (int i0 = 0; i0 < n; i0 += 256)
+    {
+        const int m = std::min(256, n - i0);
+        for (int i = 0; i < m; ++i)
+        {
+            // NaN becomes -1, below any valid index
+            const double t = v[i0 + i] * gain + offset;
+            q[i] = qint32(t == t ? std::max(0., std::min(t, lim)) : -65536.);
+        }
+        for (int i = 0; i < m; ++i)
+        {
+            const qint32 k = std::min(q[i], top) >> 16;
+            out[i0 + i] = lut[k < 0 ? invalid : k];
+        }
+    }
+}
+
+static void benchColorMapHelper(const QVector<double> &z, bool log)
+{
+    const size_t n = z.size();
+    const std::string prefix = log ? "ColorMapHelper/log" : "ColorMapHelper/linear";
+    const ColorMapHelper cmap(QMatPlotWidget::colorMap(QMatPlotWidget::Viridis, 256), true, log);
+    const QwtInterval range(0.01, 10.);
+
+    double t = timeit([&]() {
+        QRgb s = 0;
+        for (double v : z)
+            s ^= cmap.rgb(range, v);
+        doNotOptimize(s);
+    });
+    report((prefix + "/rgb").c_str(), n, t, n);
+
+    t = timeit([&]() {
+        uint s = 0;
+        for (double v : z)
+#if QWT_VERSION >= 0x060200
+            s += cmap.colorIndex(256, range, v);
+#else
+            s += cmap.colorIndex(range, v);
+#endif
+        doNotOptimize(s);
+    });
+    report((prefix + "/colorIndex").c_str(), n, t, n);
+
+    // the scanline path used by ImageSpectrogram
+    std::vector<QRgb> out(n);
+    t = timeit([&]() {
+        cmap.colorize(range, z.constData(), int(n), out.data());
+        doNotOptimize(out[n / 2]);
+    });
+    report((prefix + "/colorize").c_str(), n, t, n);
+
+    if (log)
+        return;
+    t = timeit([&]() {
+        colorizeQ16(cmap.colors(), range, z.constData(), int(n), out.data());
+        doNotOptimize(out[n / 2]);
+    });
+    report((prefix + "/colorizeQ16").c_str(), n, t, n);
+}
+
+static void benchColorMap(size_t n)
+{
+    static const struct
+    {
+        QMatPlotWidget::ColorMapType type;
+        const char *name;
+    } types[] = {{QMatPlotWidget::Viridis, "QMatPlotWidget::colorMap/Viridis"},
+                 {QMatPlotWidget::Turbo, "QMatPlotWidget::colorMap/Turbo"},
+                 {QMatPlotWidget::Jet, "QMatPlotWidget::colorMap/Jet"},
+                 {QMatPlotWidget::Gray, "QMatPlotWidget::colorMap/Gray"}};
+
+    for (const auto &t : types)
+    {
+        const double ns = timeit([&]() {
+            doNotOptimize(QMatPlotWidget::colorMap(t.type, int(n)).size());
+        });
+        report(t.name, n, ns, n);
+    }
+}
+
+void benchImage()
+{
+    std::mt19937 gen(42);
+    std::lognormal_distribution<double> dist;
+
+    for (size_t n : benchSizes())
+    {
+        const bool helper = benchEnabled("ImageHelper");
+        const bool colors = benchEnabled("ColorMapHelper");
+        if (helper || colors)
+        {
+            // positive values, with a NaN now and then
+            QVector<double> z(static_cast<int>(n));
+            for (double &v : z)
+                v = dist(gen);
+            for (size_t i = 0; i < n; i += 997)
+                z[int(i)] = qQNaN();
+
+            if (helper)
+                benchImageHelper(z);
+            if (colors)
+            {
+                benchColorMapHelper(z, false);
+                benchColorMapHelper(z, true);
+            }
+        }
+        if (benchEnabled("QMatPlotWidget::colorMap"))
+            benchColorMap(n);
+    }
+}
@@ -0,0 +1,28 @@
+#include "bench.h"
+
+#include <QMatPlotWidget>
+
+#include <QStringList>
+
+// LineSpec parsing, once per plot call; n specs are parsed per call
+void benchLineSpec()
+{
+    if (!benchEnabled("LineSpec"))
+        return;
+
+    const QStringList specs = {"", "r", "-", "--", "b.-", "ko", "g:s", "m-.^", "c--x", "y*"};
+
+    for (size_t n : benchSizes())
+    {
+        // parsing does not depend on n, larger sizes only average longer
+        if (n > 1000000)
+            break;
+        const double t = timeit([&]() {
+            int s = 0;
+            for (size_t i = 0; i < n; ++i)
+                s += QMatPlotWidget::LineSpec::fromMatlabLineSpec(specs[int(i % 10)]).markerStyle;
+            doNotOptimize(s);
+        });
+        report("LineSpec::fromMatlabLineSpec", n, t, n);
+    }
+}
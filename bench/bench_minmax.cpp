@@ -0,0 +1,76 @@
+#include "bench.h"
+
+#include "minmax_p.h"
+
+#include <cmath>
+#include <limits>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// the per-element loop formerly used by DataSeriesAdaptor::boundingRect
+template <class T>
+static void branchyMinMax(const std::vector<T> &v, double &vmin, double &vmax)
+{
+    double y1(v[0]), y2(y1);
+    for (size_t i = 1; i < v.size(); ++i)
+    {
+        if (v[i] < y1)
+            y1 = v[i];
+        else if (v[i] > y2)
+            y2 = v[i];
+    }
+    vmin = y1;
+    vmax = y2;
+}
+
+template <class T>
+static void benchType(const char *type)
+{
+    std::mt19937 gen(42);
+    std::normal_distribution<double> dist;
+    const std::string prefix = std::string("minmax/") + type;
+    // integers as from a 16-bit ADC
+    const double scale = std::is_integral<T>::value ? 1000. : 1.;
+
+    for (size_t n : benchSizes())
+    {
+        std::vector<T> v(n);
+        for (T &x : v)
+            x = T(scale * dist(gen));
+
+        const double tb = timeit([&]() {
+            double vmin, vmax;
+            branchyMinMax(v, vmin, vmax);
+            doNotOptimize(vmin + vmax);
+        });
+        report((prefix + "/branchy").c_str(), n, tb, n);
+
+        const double tk = timeit([&]() {
+            double vmin = std::numeric_limits<double>::infinity(), vmax = -vmin;
+            MinMaxKernel::reduce(v.data(), n, vmin, vmax);
+            doNotOptimize(vmin + vmax);
+        });
+        report((prefix + "/kernel").c_str(), n, tk, n);
+
+        if (!std::is_floating_point<T>::value)
+            continue;
+        // NaN every 1000 elements, as in gappy real data
+        for (size_t i = 0; i < n; i += 1000)
+            v[i] = T(NAN);
+        const double tn = timeit([&]() {
+            double vmin = std::numeric_limits<double>::infinity(), vmax = -vmin;
+            doNotOptimize(MinMaxKernel::reduce(v.data(), n, vmin, vmax));
+        });
+        report((prefix + "/kernel_nan").c_str(), n, tn, n);
+    }
+}
+
+void benchMinMax()
+{
+    benchType<double>("double");
+    benchType<float>("float");
+    benchType<qint32>("int32");
+    benchType<qint16>("int16");
+}
@@ -0,0 +1,118 @@
+#include "bench.h"
+
+#include "minmax_p.h"
+
+#include <QDateTime>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMatPlotWidget>
+#include <QSysInfo>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+/*
+ * Microbenchmarks of the library kernels.
+ *
+ * Results are written as JSON to stdout (or to --out FILE), one entry
+ * per kernel and size; progress goes to stderr. The largest sizes need
+ * a few GB of memory, use --max-size to stay below.
+ */
+
+BenchOptions benchOptions;
+
+static QJsonArray results;
+
+std::vector<size_t> benchSizes()
+{
+    std::vector<size_t> sizes;
+    for (size_t n = 1000; n <= benchOptions.maxSize; n *= 10)
+        sizes.push_back(n);
+    return sizes;
+}
+
+bool benchEnabled(const char *name)
+{
+    return !benchOptions.filter || std::strstr(name, benchOptions.filter);
+}
+
+void report(const char *name, size_t n, double ns, size_t elements)
+{
+    QJsonObject r;
+    r["name"] = name;
+    r["n"] = double(n);
+    r["ns_per_call"] = ns;
+    if (elements)
+        r["ns_per_element"] = ns / elements;
+    results.append(r);
+
+    if (elements)
+        fprintf(stderr, "%-40s n=%-10zu %12.1f ns  %8.3f ns/el\n", name, n, ns, ns / elements);
+    else
+        fprintf(stderr, "%-40s n=%-10zu %12.1f ns\n", name, n, ns);
+}
+
+static void usage()
+{
+    fprintf(stderr,
+            "usage: qmatplotwidget_bench [--filter STR] [--max-size N] "
+            "[--min-time MS] [--out FILE]\n");
+}
+
+int main(int argc, char **argv)
+{
+    const char *out = nullptr;
+    for (int i = 1; i < argc; ++i)
+    {
+        const bool hasValue = i + 1 < argc;
+        if (!std::strcmp(argv[i], "--filter") && hasValue)
+            benchOptions.filter = argv[++i];
+        else if (!std::strcmp(argv[i], "--max-size") && hasValue)
+            benchOptions.maxSize = size_t(std::atof(argv[++i]));
+        else if (!std::strcmp(argv[i], "--min-time") && hasValue)
+            benchOptions.minTime = std::atoll(argv[++i]);
+        else if (!std::strcmp(argv[i], "--out") && hasValue)
+            out = argv[++i];
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+
+    if (benchEnabled("minmax"))
+        benchMinMax();
+    benchAdaptors();
+    benchImage();
+    benchLineSpec();
+
+    QJsonObject context;
+    context["date"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    context["version"] = BENCH_VERSION;
+    context["qt_version"] = qVersion();
+    context["cpu_arch"] = QSysInfo::currentCpuArchitecture();
+    context["kernel"] = QSysInfo::kernelType() + " " + QSysInfo::kernelVersion();
+    context["minmax_isa"] = MinMaxKernel::isa();
+    context["min_time_ms"] = double(benchOptions.minTime);
+
+    QJsonObject doc;
+    doc["context"] = context;
+    doc["benchmarks"] = results;
+    const QByteArray json = QJsonDocument(doc).toJson();
+
+    if (!out)
+    {
+        fwrite(json.constData(), 1, json.size(), stdout);
+        return 0;
+    }
+    QFile f(out);
+    if (!f.open(QIODevice::WriteOnly) || f.write(json) != json.size())
+    {
+        fprintf(stderr, "cannot write %s\n", out);
+        return 1;
+    }
+    return 0;
+}
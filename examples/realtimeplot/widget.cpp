@@ -2,13 +2,12 @@
 #include <cmath>
 
 
-#define M 32
 #define PERIOD 10
 // #define N (3*1000/PERIOD)
 #define N (300)
 
 Widget::Widget(QWidget *parent) : QMatPlotWidget(parent),
-    x(N+1), y(N+1), z(N+1), toff(0), t_(M)
+    toff(0)
 {
 //    for(int i=0; i<=N; ++i)
 //    {
@@ -20,8 +19,8 @@ Widget::Widget(QWidget *parent) : QMatPlotWidget(parent),
     kt = 1.*PERIOD/1000;
     ky = 2.*M_PI*3./N;
 
-    plot(x,y,QString("o-"));
-    plot(x,z,QString("^--"));
+    xy = stream(N+1, QString("o-"));
+    z = stream(N+1, QString("^--"));
     setTitle("QMatPlotWidget, FPS=");
     setXlabel("t (s)");
     setYlabel("sin(ωt)");
@@ -29,8 +28,9 @@ Widget::Widget(QWidget *parent) : QMatPlotWidget(parent),
     //setYlim(QPointF(-1.1,1.1));
     setGrid(1);
 
-    t_.fill(0.f);
-    clock_.start();
+    // the frames actually rendered, not the replot requests
+    connect(this, &QMatPlotWidget::renderStatsUpdated, this, &Widget::onRenderStats);
+    setStatsInterval(1000);
     startTimer(PERIOD);
 }
 
@@ -39,26 +39,25 @@ Widget::~Widget()
 
 }
 
-void Widget::timerEvent( QTimerEvent * )
+void Widget::onRenderStats(const QMatPlotWidget::RenderStats &s)
 {
-    t_[toff & (M-1)] = 1.e-9f * clock_.nsecsElapsed();
+    setTitle(QString("QMatPlotWidget, FPS=%1, frame p95=%2 ms, replots=%3/%4")
+                 .arg(s.fps,0,'f',1)
+                 .arg(s.p95FrameTime,0,'f',2)
+                 .arg(s.replotsPerformed)
+                 .arg(s.replotsRequested));
+}
 
+void Widget::timerEvent( QTimerEvent * )
+{
     //y.incOffset();
 
     //if ((toff % 3)==0) z.decOffset();
 
-    x.push(kt*toff);
-    y.push(sin(0.02*ky*toff)*sin(ky*toff));
-    z.push(0.3*(rng.generateDouble()-0.5));
+    xy.append(kt*toff, sin(0.02*ky*toff)*sin(ky*toff));
+    z.append(kt*toff, 0.3*(rng.generateDouble()-0.5));
 
     replot();
 
-    if ((toff % 500)==0) {
-        int i2 = toff & (M-1);
-        int i1 = (i2+1) & (M-1);
-        float FPS = 1.f*(M-1)/(t_[i2] - t_[i1]);
-        setTitle(QString("QMatPlotWidget, FPS=%1").arg(FPS,0,'f',1));
-    }
-
     toff++;
 }
@@ -3,7 +3,6 @@
 
 
 #include <QVector>
-#include <QElapsedTimer>
 #include <QRandomGenerator>
 
 #include <QMatPlotWidget>
@@ -43,63 +42,18 @@ public:
     void decOffset() { d_ptr->offset_--; }
 };
 
-// explicitly shared circular buffer class
-class CircularBuffer
-{
-    typedef QVector<double> vector_t;
-    struct myshareddata : QSharedData {
-        vector_t v;
-        int n;
-        int idx;
-        explicit myshareddata(int sz) : v(sz, 0.), n(0), idx(0)
-        {}
-        explicit myshareddata(const myshareddata& o) : QSharedData(o),
-            v(o.v), n(o.n), idx(o.idx)
-        {}
-        void push(const double& d) {
-            v[idx++] = d;
-            idx %= v.size();
-            if (n<v.size()) n++;
-        }
-        int didx(int i) const {
-            if (n<v.size()) return i;
-            else return (idx + i) % n;
-        }
-    };
-    QExplicitlySharedDataPointer<myshareddata> d_ptr;
-
-public:
-
-    explicit CircularBuffer(int n) : d_ptr(new myshareddata(n))
-    {}
-    explicit CircularBuffer(const CircularBuffer& v) : d_ptr(v.d_ptr)
-    {}
-
-    int size() const { return d_ptr->n; }
-//    double & operator[](int i) {
-//        int j = d_ptr->didx(i);
-//        return d_ptr->v[j];
-//    }
-    const double & operator[](int i) const {
-        int j = d_ptr->didx(i);
-        return d_ptr->v[j];
-    }
-    void push(const double& d) {
-        d_ptr->push(d);
-    }
-
-};
-
-
 class Widget : public QMatPlotWidget
 {
     Q_OBJECT
 
     //SharedVector x,y,z;
-    CircularBuffer x,y,z;
+    // Scrolling series are streams: a ring buffer container would shift
+    // all its indexes with each sample once full, invalidating the whole
+    // series for its adaptor every frame, while a stream accounts for
+    // the overwritten samples only
+    StreamWriter xy;
+    StreamWriter z; // could be fed from an acquisition thread
     int toff;
-    QElapsedTimer clock_;
-    QVector<float> t_;
 
     double kt,ky;
 
@@ -112,6 +66,9 @@ public:
 protected:
     void timerEvent( QTimerEvent *e ) override;
 
+private slots:
+    void onRenderStats(const QMatPlotWidget::RenderStats &s);
+
 
 };
 
@@ -28,11 +28,13 @@ int main(int argc, char *argv[])
             x[i] = -1. + 2. * i / N;
             y1[i] = x[i] * x[i];
             y2[i] = y1[i] * x[i];
-            // test for NaN values
-            //if (std::fabs(x[i]) < 0.25)
-            // y1[i] = NAN;
+            // NaN values break the line
+            if (std::fabs(x[i]) < 0.25)
+                y1[i] = NAN;
         }
 
+        // layout and render once, after all the changes
+        QMatPlotWidget::UpdateGuard batch(w);
         w->plot(x, y1, "o-");
         w->plot(x, y2, "^-");
         w->plot(Vector({0, 0}), Vector({-1, 1}), "k-");
@@ -0,0 +1,284 @@
+#include "qmatplotwidget.h"
+#include "adaptors_p.h"
+
+#include <QtMath>
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+namespace {
+
+// Values of one axis of a series read by fn(i), for series that do not
+// publish their memory
+template <class Fn>
+struct StoredValues
+{
+    Fn fn;
+    double operator[](int i) const { return fn(i); }
+};
+template <class Fn>
+inline StoredValues<Fn> storedValues(Fn fn)
+{
+    return StoredValues<Fn>{fn};
+}
+
+// Call f(x, y) with the memory of v as DataView of its element type T,
+// x empty if it is the sample index
+template <class T, class F>
+inline decltype(auto) withViewDataOf(const SeriesView &v, F f)
+{
+    const DataView<T> x(static_cast<const T *>(v.x), v.x ? v.size : 0);
+    const DataView<T> y(static_cast<const T *>(v.y), v.size);
+    return f(x, y);
+}
+// as withViewDataOf(), for the element type of v
+template <class F>
+inline decltype(auto) withViewData(const SeriesView &v, F f)
+{
+    switch (v.ytype)
+    {
+    case SeriesView::Float:
+        return withViewDataOf<float>(v, f);
+    case SeriesView::Int32:
+        return withViewDataOf<qint32>(v, f);
+    case SeriesView::Int16:
+        return withViewDataOf<qint16>(v, f);
+    default:
+        return withViewDataOf<double>(v, f);
+    }
+}
+
+// true if the memory of the samples is contiguous, of one element type
+inline bool contiguous(const SeriesView &v)
+{
+    return v.xstride == 1 && v.ystride == 1 && uniformTypes(v);
+}
+
+} // namespace
+
+/*---- SeriesCache -------*/
+
+const OrderedExtents &SeriesCache::extents(const CachedSeriesAdaptor &a)
+{
+    const bool hasX = a.hasX();
+    auto scan = [&](const auto &x, const auto &y) -> const OrderedExtents & {
+        return extents_.extents(a.size(), [&](int from, int to) {
+            OrderedExtents e;
+            if (hasX)
+                e.scanX(x, from, to);
+            else
+                e.scanIndexes(from, to);
+            minMaxOf(y, from, to, e.y1, e.y2, 0);
+            return e;
+        });
+    };
+    SeriesView v;
+    if (a.view(v) && contiguous(v))
+        return withViewData(v, scan);
+    return scan(storedValues([&a](int i) { return a.storedSample(i).x(); }),
+                storedValues([&a](int i) { return a.storedSample(i).y(); }));
+}
+
+const QVector<SeriesSegment> &SeriesCache::segments(const CachedSeriesAdaptor &a)
+{
+    const bool hasX = a.hasX();
+    auto index = [&](const auto &x, const auto &y) -> const QVector<SeriesSegment> & {
+        return segments_.segments(a.size(), [&](int i) {
+            return qIsNaN(double(y[i])) || (hasX && qIsNaN(double(x[i])));
+        });
+    };
+    SeriesView v;
+    if (a.view(v) && contiguous(v))
+        return withViewData(v, index);
+    return index(storedValues([&a](int i) { return a.storedSample(i).x(); }),
+                 storedValues([&a](int i) { return a.storedSample(i).y(); }));
+}
+
+const SeriesExtents &SeriesCache::values(const CachedSeriesAdaptor &a)
+{
+    const int n = a.valueCount();
+    auto scan = [&](const auto &c) -> const SeriesExtents & {
+        return values_.extents(n, [&](int from, int to) {
+            SeriesExtents e;
+            minMaxOf(c, from, to, e.y1, e.y2, 0);
+            return e;
+        });
+    };
+    SeriesView v;
+    v.y = a.valueData(v.ytype);
+    v.size = n;
+    if (v.y)
+        return withViewData(v, [&](const auto &, const auto &c) -> const SeriesExtents & {
+            return scan(c);
+        });
+    return scan(storedValues([&a](int i) { return a.storedValue(i); }));
+}
+
+/*---- ErrorBarCache -------*/
+
+const ErrorBarExtents &ErrorBarCache::extents(const CachedErrorBarAdaptor &a)
+{
+    const bool hasX = a.hasX();
+    const double err = a.commonError();
+    auto scan = [&](const auto &x, const auto &y) -> const ErrorBarExtents & {
+        return extents_.extents(a.size(), [&](int from, int to) {
+            ErrorBarExtents e;
+            if (hasX)
+                e.data.scanX(x, from, to);
+            else
+                e.data.scanIndexes(from, to);
+            e.errors.x1 = e.data.x1;
+            e.errors.x2 = e.data.x2;
+            minMaxOf(y, from, to, e.data.y1, e.data.y2, 0);
+            if (qIsNaN(err))
+                a.scanErrors(from, to, e.errors.y1, e.errors.y2);
+            else if (e.data.y1 <= e.data.y2)
+            {
+                // the error bars follow the data
+                e.errors.y1 = e.data.y1 - err;
+                e.errors.y2 = e.data.y2 + err;
+            }
+            return e;
+        });
+    };
+    SeriesView v;
+    if (a.view(v) && contiguous(v))
+        return withViewData(v, scan);
+    return scan(storedValues([&a](int i) { return a.storedSample(i).x(); }),
+                storedValues([&a](int i) { return a.storedSample(i).y(); }));
+}
+
+const QVector<SeriesSegment> &ErrorBarCache::segments(const CachedErrorBarAdaptor &a)
+{
+    const bool hasX = a.hasX();
+    auto index = [&](const auto &x, const auto &y) -> const QVector<SeriesSegment> & {
+        return segments_.segments(a.size(), [&](int i) {
+            return qIsNaN(double(y[i])) || (hasX && qIsNaN(double(x[i])));
+        });
+    };
+    SeriesView v;
+    if (a.view(v) && contiguous(v))
+        return withViewData(v, index);
+    return index(storedValues([&a](int i) { return a.storedSample(i).x(); }),
+                 storedValues([&a](int i) { return a.storedSample(i).y(); }));
+}
+
+/*---- CachedSeriesAdaptor -------*/
+
+CachedSeriesAdaptor::CachedSeriesAdaptor()
+    : cache_(new SeriesCache)
+{
+}
+
+CachedSeriesAdaptor::CachedSeriesAdaptor(const CachedSeriesAdaptor &other)
+    : AbstractDataSeriesAdaptor(other)
+    , cache_(new SeriesCache(*other.cache_))
+{
+}
+
+CachedSeriesAdaptor::~CachedSeriesAdaptor() {}
+
+QRectF CachedSeriesAdaptor::boundingRect() const
+{
+    // the extents are of the stored values
+    return cache_->extents(*this).scaled(xScale, yScale).rect();
+}
+
+bool CachedSeriesAdaptor::sortedX() const
+{
+    return (xSorted || !hasX() || cache_->extents(*this).sorted) && xScale.scale >= 0.;
+}
+
+void CachedSeriesAdaptor::dataChanged(int from, int to)
+{
+    cache_->changed(from, to);
+}
+
+void CachedSeriesAdaptor::invalidate()
+{
+    cache_->invalidate();
+}
+
+void CachedSeriesAdaptor::cachedValueRange(double &vmin, double &vmax) const
+{
+    const SeriesExtents &e = cache_->values(*this);
+    vmin = e.y1;
+    vmax = e.y2;
+}
+
+void CachedSeriesAdaptor::valuesChanged()
+{
+    cache_->valuesChanged();
+}
+
+/*---- CachedErrorBarAdaptor -------*/
+
+CachedErrorBarAdaptor::CachedErrorBarAdaptor()
+    : cache_(new ErrorBarCache)
+{
+}
+
+CachedErrorBarAdaptor::CachedErrorBarAdaptor(const CachedErrorBarAdaptor &other)
+    : AbstractErrorBarAdaptor(other)
+    , cache_(new ErrorBarCache(*other.cache_))
+{
+}
+
+CachedErrorBarAdaptor::~CachedErrorBarAdaptor() {}
+
+QRectF CachedErrorBarAdaptor::boundingRect() const
+{
+    return cache_->extents(*this).data.scaled(xScale, yScale).rect();
+}
+
+QRectF CachedErrorBarAdaptor::errorBoundingRect() const
+{
+    return cache_->extents(*this).errors.scaled(xScale, yScale).rect();
+}
+
+bool CachedErrorBarAdaptor::sortedX() const
+{
+    return (!hasX() || cache_->extents(*this).data.sorted) && xScale.scale >= 0.;
+}
+
+void CachedErrorBarAdaptor::dataChanged(int from, int to)
+{
+    cache_->changed(from, to);
+}
+
+void CachedErrorBarAdaptor::invalidate()
+{
+    cache_->invalidate();
+}
+
+/*---- AbstractImageAdaptor -------*/
+
+QPointF AbstractImageAdaptor::zlim() const
+{
+    const double inf = std::numeric_limits<double>::infinity();
+    const int n = rows() * columns();
+    const double *z = valueData();
+    const int tasks = parallelTasks(n, 4096);
+    std::vector<QPointF> partial(tasks, QPointF(inf, -inf));
+    parallelFor(tasks, n, 4096, [&](int t, int from, int to) {
+        if (z)
+            minMaxOf(DataView<double>(z, n), from, to, partial[t].rx(), partial[t].ry(), 0);
+        else
+            minMaxOf(storedValues([this](int k) { return value(k); }),
+                     from,
+                     to,
+                     partial[t].rx(),
+                     partial[t].ry(),
+                     0);
+    });
+    double vmin = inf, vmax = -inf;
+    for (const QPointF &p : partial)
+    {
+        vmin = std::min(vmin, p.x());
+        vmax = std::max(vmax, p.y());
+    }
+    if (!(vmin <= vmax))
+        return QPointF(0., 1.);
+    return QPointF(vmin, vmax);
+}
@@ -0,0 +1,411 @@
+#ifndef _ADAPTORS_P_H_
+#define _ADAPTORS_P_H_
+
+#include "qmatplotwidget.h"
+#include "minmax_p.h"
+#include "parallel_p.h"
+
+#include <QRectF>
+#include <QVector>
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+/*---- Cached data extents -------*/
+
+// Bounding box of a set of samples. NaN values are ignored.
+struct SeriesExtents
+{
+    double x1{std::numeric_limits<double>::infinity()};
+    double x2{-std::numeric_limits<double>::infinity()};
+    double y1{std::numeric_limits<double>::infinity()};
+    double y2{-std::numeric_limits<double>::infinity()};
+
+    bool isEmpty() const { return !(x1 <= x2 && y1 <= y2); }
+    void addX(double x)
+    {
+        if (x < x1)
+            x1 = x;
+        if (x > x2)
+            x2 = x;
+    }
+    void addY(double y)
+    {
+        if (y < y1)
+            y1 = y;
+        if (y > y2)
+            y2 = y;
+    }
+    void add(double x, double y)
+    {
+        addX(x);
+        addY(y);
+    }
+    void unite(const SeriesExtents &o)
+    {
+        x1 = std::min(x1, o.x1);
+        x2 = std::max(x2, o.x2);
+        y1 = std::min(y1, o.y1);
+        y2 = std::max(y2, o.y2);
+    }
+    QRectF rect() const { return isEmpty() ? QRectF() : QRectF(x1, y1, x2 - x1, y2 - y1); }
+    // extents of the values mapped by sx and sy
+    SeriesExtents scaled(const SampleScale &sx, const SampleScale &sy) const
+    {
+        if (isEmpty())
+            return *this;
+        SeriesExtents e;
+        e.add(sx(x1), sy(y1));
+        e.add(sx(x2), sy(y2));
+        return e;
+    }
+};
+
+// Extents of a series, also telling if its x values are sorted.
+// unite() expects the extents of consecutive samples in index order,
+// which is how BasicExtentsCache combines them.
+struct OrderedExtents : public SeriesExtents
+{
+    bool sorted{true}; // x non-decreasing, without NaN
+    bool none{true};   // no samples
+    double xfirst{0}, xlast{0};
+
+    // x is the sample index, for samples [from, to)
+    void scanIndexes(int from, int to)
+    {
+        if (from >= to)
+            return;
+        addX(from);
+        addX(to - 1);
+        none = false;
+        xfirst = from;
+        xlast = to - 1;
+    }
+    // x is v[from, to)
+    template <class V_>
+    void scanX(const V_ &v, int from, int to)
+    {
+        if (from >= to)
+            return;
+        none = false;
+        xfirst = v[from];
+        xlast = v[to - 1];
+        // checked in chunks without early exit inside, which vectorizes
+        sorted = xfirst == xfirst;
+        for (int i = from; sorted && i + 1 < to;)
+        {
+            const int j = std::min(to - 1, i + 1024);
+            bool descent = false;
+            for (int k = i; k < j; ++k)
+                descent |= !(v[k] <= v[k + 1]);
+            sorted = !descent;
+            i = j;
+        }
+        if (sorted)
+        {
+            x1 = std::min(x1, xfirst);
+            x2 = std::max(x2, xlast);
+        }
+        else
+            minMaxOf(v, from, to, x1, x2, 0);
+    }
+    void unite(const OrderedExtents &o)
+    {
+        SeriesExtents::unite(o);
+        if (o.none)
+            return;
+        if (none)
+        {
+            sorted = o.sorted;
+            xfirst = o.xfirst;
+            none = false;
+        }
+        else
+            sorted = sorted && o.sorted && xlast <= o.xfirst;
+        xlast = o.xlast;
+    }
+};
+
+// Extents of a series, cached per block of samples.
+//
+// Samples appended since the last query are folded into the cached
+// extents, blocks reported by changed() are rescanned, and the whole
+// series is rescanned only after invalidate() or if it has shrunk.
+// The scan function passed to extents() returns the extents E of the
+// samples [from, to); E is default constructed empty and has unite().
+// Blocks of large series are scanned in parallel, see parallelFor(),
+// so the scan function has to be reentrant.
+template <class E>
+class BasicExtentsCache
+{
+    QVector<E> blocks_;
+    E total_;
+    int n_{0};
+    int dirtyFrom_{0}, dirtyTo_{0};
+    bool valid_{false};
+
+private:
+    // scan the blocks [b1, b2) of n samples
+    template <class ScanFn>
+    void scanBlocks(int b1, int b2, int n, ScanFn &scan)
+    {
+        E *blocks = blocks_.data();
+        const int from = b1 * BlockSize;
+        const int m = std::min(n, b2 * BlockSize) - from;
+        parallelFor(parallelTasks(m, BlockSize), m, BlockSize, [&](int, int i, int j) {
+            for (; i < j; i += BlockSize)
+                blocks[(from + i) / BlockSize] = scan(from + i, from + std::min(j, i + BlockSize));
+        });
+    }
+
+public:
+    enum { BlockSize = 4096 };
+
+    void invalidate() { valid_ = false; }
+    void changed(int from, int to)
+    {
+        if (dirtyFrom_ < dirtyTo_)
+        {
+            dirtyFrom_ = std::min(dirtyFrom_, from);
+            dirtyTo_ = std::max(dirtyTo_, to);
+        }
+        else
+        {
+            dirtyFrom_ = from;
+            dirtyTo_ = to;
+        }
+    }
+
+    template <class ScanFn>
+    const E &extents(int n, ScanFn scan)
+    {
+        const int nblocks = (n + BlockSize - 1) / BlockSize;
+
+        if (!valid_ || n < n_)
+        {
+            blocks_.resize(nblocks);
+            scanBlocks(0, nblocks, n, scan);
+            total_ = E();
+            for (const E &e : blocks_)
+                total_.unite(e);
+            n_ = n;
+            dirtyFrom_ = dirtyTo_ = 0;
+            valid_ = true;
+            return total_;
+        }
+
+        if (dirtyFrom_ < dirtyTo_)
+        {
+            const int b1 = std::max(dirtyFrom_, 0) / BlockSize;
+            const int b2 = std::min((std::min(dirtyTo_, n_) + BlockSize - 1) / BlockSize,
+                                    int(blocks_.size()));
+            if (b1 < b2)
+                scanBlocks(b1, b2, n_, scan);
+            total_ = E();
+            for (const E &e : blocks_)
+                total_.unite(e);
+            dirtyFrom_ = dirtyTo_ = 0;
+        }
+
+        if (n > n_)
+        {
+            blocks_.resize(nblocks);
+            for (int i = n_; i < n;)
+            {
+                const int b = i / BlockSize;
+                const int j = std::min(n, (b + 1) * BlockSize);
+                const E e = scan(i, j);
+                blocks_[b].unite(e);
+                total_.unite(e);
+                i = j;
+            }
+            n_ = n;
+        }
+
+        return total_;
+    }
+};
+
+using ExtentsCache = BasicExtentsCache<SeriesExtents>;
+
+/*---- NaN gaps -------*/
+
+// Run of samples [from, to) without NaN. Lines are broken at NaN, as
+// in MATLAB, and each run is drawn as one polyline.
+struct SeriesSegment
+{
+    int from;
+    int to;
+};
+
+// Append to out the runs of the samples [from, to) for which isGap(i)
+// is false, extending the last run of out if adjacent
+template <class GapFn>
+inline void appendSegments(int from, int to, GapFn isGap, QVector<SeriesSegment> &out)
+{
+    auto add = [&out](int b, int e) {
+        if (b >= e)
+            return;
+        if (!out.isEmpty() && out.last().to == b)
+            out.last().to = e;
+        else
+            out.append(SeriesSegment{b, e});
+    };
+    int begin = from;
+    for (int i = from; i < to; ++i)
+    {
+        if (!isGap(i))
+            continue;
+        add(begin, i);
+        begin = i + 1;
+    }
+    add(begin, to);
+}
+
+// Runs of samples without NaN of a series, cached until invalidate().
+// Samples appended since the last query are scanned on their own, and
+// large series are scanned in parallel, see parallelFor().
+class SegmentIndex
+{
+    QVector<SeriesSegment> segments_;
+    int n_{0};
+    bool valid_{false};
+
+public:
+    void invalidate() { valid_ = false; }
+
+    // isGap(i) is true if sample i has a NaN coordinate
+    template <class GapFn>
+    const QVector<SeriesSegment> &segments(int n, GapFn isGap)
+    {
+        if (!valid_ || n < n_)
+        {
+            segments_.clear();
+            n_ = 0;
+        }
+        if (n > n_)
+        {
+            const int m = n - n_, from = n_;
+            const int tasks = parallelTasks(m, 4096);
+            std::vector<QVector<SeriesSegment>> parts(tasks);
+            parallelFor(tasks, m, 4096, [&](int t, int i, int j) {
+                appendSegments(from + i, from + j, isGap, parts[t]);
+            });
+            // runs ending at a task bound are joined here
+            for (const QVector<SeriesSegment> &part : parts)
+                for (const SeriesSegment &r : part)
+                    appendSegments(r.from, r.to, [](int) { return false; }, segments_);
+        }
+        n_ = n;
+        valid_ = true;
+        return segments_;
+    }
+};
+
+/*---- Raw access to contiguous data -------*/
+
+// true if x, if any, is of the element type of y: the views read by
+// withSeriesView(); others are read by sample()
+inline bool uniformTypes(const SeriesView &v)
+{
+    return !v.x || v.xtype == v.ytype;
+}
+
+// Call f(sample) with an accessor sample(i) -> QPointF reading the
+// memory of v in its element type T, scaled
+template <class T, class F>
+inline auto withSeriesViewOf(const SeriesView &v, F f)
+{
+    const T *x = static_cast<const T *>(v.x);
+    const T *y = static_cast<const T *>(v.y);
+    const std::ptrdiff_t xs = v.xstride, ys = v.ystride;
+    const SampleScale sx = v.xscale, sy = v.yscale;
+    if (x)
+        return f([=](int i) { return QPointF(sx(x[i * xs]), sy(y[i * ys])); });
+    return f([=](int i) { return QPointF(sx(i), sy(y[i * ys])); });
+}
+// as withSeriesViewOf(), for the element type of v
+template <class F>
+inline auto withSeriesView(const SeriesView &v, F f)
+{
+    switch (v.ytype)
+    {
+    case SeriesView::Float:
+        return withSeriesViewOf<float>(v, f);
+    case SeriesView::Int32:
+        return withSeriesViewOf<qint32>(v, f);
+    case SeriesView::Int16:
+        return withSeriesViewOf<qint16>(v, f);
+    default:
+        return withSeriesViewOf<double>(v, f);
+    }
+}
+
+/*---- Caches of the adaptors of containers -------*/
+
+// Extents and runs without NaN of the stored samples of a
+// CachedSeriesAdaptor. The samples are read from the memory published
+// by view() if possible, with the MinMaxKernel, else by storedSample().
+class SeriesCache
+{
+public:
+    const OrderedExtents &extents(const CachedSeriesAdaptor &a);
+    const QVector<SeriesSegment> &segments(const CachedSeriesAdaptor &a);
+    // range of the color values, in y1 and y2
+    const SeriesExtents &values(const CachedSeriesAdaptor &a);
+    void changed(int from, int to)
+    {
+        extents_.changed(from, to);
+        segments_.invalidate();
+        values_.changed(from, to);
+    }
+    void invalidate()
+    {
+        extents_.invalidate();
+        segments_.invalidate();
+        values_.invalidate();
+    }
+    void valuesChanged() { values_.invalidate(); }
+
+private:
+    BasicExtentsCache<OrderedExtents> extents_;
+    SegmentIndex segments_;
+    ExtentsCache values_;
+};
+
+// extents of the samples and of the error bars, found in one pass
+struct ErrorBarExtents
+{
+    OrderedExtents data;
+    SeriesExtents errors;
+    void unite(const ErrorBarExtents &o)
+    {
+        data.unite(o.data);
+        errors.unite(o.errors);
+    }
+};
+
+// As SeriesCache, for a CachedErrorBarAdaptor
+class ErrorBarCache
+{
+public:
+    const ErrorBarExtents &extents(const CachedErrorBarAdaptor &a);
+    const QVector<SeriesSegment> &segments(const CachedErrorBarAdaptor &a);
+    void changed(int from, int to)
+    {
+        extents_.changed(from, to);
+        segments_.invalidate();
+    }
+    void invalidate()
+    {
+        extents_.invalidate();
+        segments_.invalidate();
+    }
+
+private:
+    BasicExtentsCache<ErrorBarExtents> extents_;
+    SegmentIndex segments_;
+};
+
+#endif // _ADAPTORS_P_H_
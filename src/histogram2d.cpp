@@ -0,0 +1,118 @@
+#include "qmatplotwidget.h"
+#include "qmatplotwidget_p.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+// least number of points per binning task
+const int MinChunk = 1 << 18;
+
+// bin grid: nx x ny bins from (x0, y0), sx x sy bins per unit
+struct Grid
+{
+    double x0, y0, sx, sy;
+    int nx, ny;
+};
+
+// count the points [from, to) into h, skipping those outside the grid;
+// the right and top edges fall in the last bins
+template <class SampleFn>
+void countBins(SampleFn sample, int from, int to, const Grid &g, quint32 *h)
+{
+    for (int i = from; i < to; ++i)
+    {
+        const QPointF p = sample(i);
+        const double fx = (p.x() - g.x0) * g.sx;
+        const double fy = (p.y() - g.y0) * g.sy;
+        if (!(fx >= 0. && fx <= g.nx && fy >= 0. && fy <= g.ny))
+            continue; // also NaN
+        const int bx = std::min(int(fx), g.nx - 1);
+        const int by = std::min(int(fy), g.ny - 1);
+        ++h[by * g.nx + bx];
+    }
+}
+
+// r widened where it is degenerate, so that bins have a size
+QRectF padded(QRectF r)
+{
+    if (!(r.width() > 0.))
+        r = QRectF(r.left() - 0.5, r.top(), 1., r.height());
+    if (!(r.height() > 0.))
+        r = QRectF(r.left(), r.top() - 0.5, r.width(), 1.);
+    return r;
+}
+
+} // namespace
+
+Histogram2D::Histogram2D(AbstractDataSeriesAdaptor *points, int nx, int ny)
+    : points_(points)
+    , nx_(std::max(nx, 1))
+    , ny_(std::max(ny, 1))
+{
+    invalidate();
+    setArea(extents());
+}
+
+void Histogram2D::invalidate()
+{
+    points_->invalidate();
+    extents_ = padded(points_->boundingRect());
+    // count again, also over the same area
+    stale_ = true;
+}
+
+bool Histogram2D::setArea(const QRectF &area)
+{
+    if (area.isEmpty() || (!stale_ && bins_.area == area))
+        return false;
+    bins_ = bin(area);
+    stale_ = false;
+    return true;
+}
+
+Histogram2D::Bins Histogram2D::bin(const QRectF &area) const
+{
+    const AbstractDataSeriesAdaptor *d = points_.get();
+    const int n = d->size();
+    const int cells = nx_ * ny_;
+    const Grid g{area.left(), area.top(), nx_ / area.width(), ny_ / area.height(), nx_, ny_};
+
+    SeriesView v;
+    const bool direct = d->view(v) && uniformTypes(v);
+    auto count = [&](int from, int to, quint32 *h) {
+        if (direct)
+            withSeriesView(v, [&](auto sample) { countBins(sample, from, to, g, h); });
+        else
+            countBins([d](int i) { return d->sample(i); }, from, to, g, h);
+    };
+
+    // one partial histogram per task, bounded in memory by the points
+    const int tasks = std::max(1, std::min(parallelTasks(n, MinChunk), n / cells));
+    std::vector<std::vector<quint32>> partial(tasks, std::vector<quint32>(cells));
+    parallelFor(tasks, n, MinChunk, [&](int t, int from, int to) {
+        count(from, to, partial[t].data());
+    });
+
+    Bins b;
+    b.area = area;
+    b.counts.resize(cells);
+    double cmin = std::numeric_limits<double>::infinity(), cmax = 0.;
+    for (int k = 0; k < cells; ++k)
+    {
+        quint64 c = 0;
+        for (int t = 0; t < tasks; ++t)
+            c += partial[t][k];
+        if (c)
+        {
+            b.counts[k] = double(c);
+            cmin = std::min(cmin, double(c));
+            cmax = std::max(cmax, double(c));
+        }
+        else
+            b.counts[k] = qQNaN(); // transparent
+    }
+    b.zlim = cmax > 0. ? QPointF(cmin, cmax) : QPointF(0., 1.);
+    return b;
+}
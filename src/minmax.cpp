@@ -0,0 +1,374 @@
+#include "minmax_p.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MINMAX_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(MINMAX_X86) && (defined(__GNUC__) || defined(__clang__))
+#define MINMAX_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define MINMAX_TARGET_AVX2
+#endif
+
+#include <limits>
+
+/*
+ * Min/max reductions over contiguous data.
+ *
+ * The vector kernels rely on the semantics of the SSE/AVX min/max
+ * instructions: if either operand is NaN the second one is returned.
+ * Passing the data as first operand and the accumulator as second
+ * skips NaN elements for free. NaNs are detected separately with an
+ * unordered compare, which costs one instruction per vector.
+ *
+ * Integers have no NaN. Their lanes start at the type limits, which are
+ * not neutral for [vmin, vmax], so they are folded only if loaded.
+ */
+
+namespace {
+
+template <class T>
+bool minmax_generic(const T *v, size_t n, double &vmin, double &vmax)
+{
+    bool nan = false;
+    for (size_t i = 0; i < n; ++i)
+    {
+        const double x = v[i];
+        if (x < vmin)
+            vmin = x;
+        if (x > vmax)
+            vmax = x;
+        if (x != x)
+            nan = true;
+    }
+    return nan;
+}
+
+// fold the per-lane results mn[0, m), mx[0, m) into [vmin, vmax]
+template <class T>
+void fold(const T *mn, const T *mx, int m, double &vmin, double &vmax)
+{
+    for (int k = 0; k < m; ++k)
+    {
+        if (mn[k] < vmin)
+            vmin = mn[k];
+        if (mx[k] > vmax)
+            vmax = mx[k];
+    }
+}
+
+#ifdef MINMAX_X86
+
+// SSE2 has no 32-bit integer min/max
+inline __m128i min_epi32(__m128i a, __m128i b)
+{
+    const __m128i gt = _mm_cmpgt_epi32(a, b);
+    return _mm_or_si128(_mm_and_si128(gt, b), _mm_andnot_si128(gt, a));
+}
+inline __m128i max_epi32(__m128i a, __m128i b)
+{
+    const __m128i gt = _mm_cmpgt_epi32(a, b);
+    return _mm_or_si128(_mm_and_si128(gt, a), _mm_andnot_si128(gt, b));
+}
+
+bool minmax_sse2(const double *v, size_t n, double &vmin, double &vmax)
+{
+    __m128d mn0 = _mm_set1_pd(std::numeric_limits<double>::infinity());
+    __m128d mx0 = _mm_set1_pd(-std::numeric_limits<double>::infinity());
+    __m128d mn1 = mn0, mx1 = mx0;
+    __m128d nan = _mm_setzero_pd();
+
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        const __m128d a = _mm_loadu_pd(v + i);
+        const __m128d b = _mm_loadu_pd(v + i + 2);
+        mn0 = _mm_min_pd(a, mn0);
+        mx0 = _mm_max_pd(a, mx0);
+        mn1 = _mm_min_pd(b, mn1);
+        mx1 = _mm_max_pd(b, mx1);
+        nan = _mm_or_pd(nan, _mm_cmpunord_pd(a, b));
+    }
+
+    double mn[2], mx[2];
+    _mm_storeu_pd(mn, _mm_min_pd(mn0, mn1));
+    _mm_storeu_pd(mx, _mm_max_pd(mx0, mx1));
+    fold(mn, mx, 2, vmin, vmax);
+
+    const bool hasNaN = _mm_movemask_pd(nan) != 0;
+    return minmax_generic(v + i, n - i, vmin, vmax) || hasNaN;
+}
+
+bool minmax_sse2(const float *v, size_t n, double &vmin, double &vmax)
+{
+    __m128 mn0 = _mm_set1_ps(std::numeric_limits<float>::infinity());
+    __m128 mx0 = _mm_set1_ps(-std::numeric_limits<float>::infinity());
+    __m128 mn1 = mn0, mx1 = mx0;
+    __m128 nan = _mm_setzero_ps();
+
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        const __m128 a = _mm_loadu_ps(v + i);
+        const __m128 b = _mm_loadu_ps(v + i + 4);
+        mn0 = _mm_min_ps(a, mn0);
+        mx0 = _mm_max_ps(a, mx0);
+        mn1 = _mm_min_ps(b, mn1);
+        mx1 = _mm_max_ps(b, mx1);
+        nan = _mm_or_ps(nan, _mm_cmpunord_ps(a, b));
+    }
+
+    float mn[4], mx[4];
+    _mm_storeu_ps(mn, _mm_min_ps(mn0, mn1));
+    _mm_storeu_ps(mx, _mm_max_ps(mx0, mx1));
+    fold(mn, mx, 4, vmin, vmax);
+
+    const bool hasNaN = _mm_movemask_ps(nan) != 0;
+    return minmax_generic(v + i, n - i, vmin, vmax) || hasNaN;
+}
+
+bool minmax_sse2(const qint32 *v, size_t n, double &vmin, double &vmax)
+{
+    __m128i mn0 = _mm_set1_epi32(std::numeric_limits<qint32>::max());
+    __m128i mx0 = _mm_set1_epi32(std::numeric_limits<qint32>::min());
+    __m128i mn1 = mn0, mx1 = mx0;
+
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(v + i));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(v + i + 4));
+        mn0 = min_epi32(a, mn0);
+        mx0 = max_epi32(a, mx0);
+        mn1 = min_epi32(b, mn1);
+        mx1 = max_epi32(b, mx1);
+    }
+
+    if (i)
+    {
+        qint32 mn[4], mx[4];
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(mn), min_epi32(mn0, mn1));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(mx), max_epi32(mx0, mx1));
+        fold(mn, mx, 4, vmin, vmax);
+    }
+    return minmax_generic(v + i, n - i, vmin, vmax);
+}
+
+bool minmax_sse2(const qint16 *v, size_t n, double &vmin, double &vmax)
+{
+    __m128i mn0 = _mm_set1_epi16(std::numeric_limits<qint16>::max());
+    __m128i mx0 = _mm_set1_epi16(std::numeric_limits<qint16>::min());
+    __m128i mn1 = mn0, mx1 = mx0;
+
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(v + i));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(v + i + 8));
+        mn0 = _mm_min_epi16(a, mn0);
+        mx0 = _mm_max_epi16(a, mx0);
+        mn1 = _mm_min_epi16(b, mn1);
+        mx1 = _mm_max_epi16(b, mx1);
+    }
+
+    if (i)
+    {
+        qint16 mn[8], mx[8];
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(mn), _mm_min_epi16(mn0, mn1));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(mx), _mm_max_epi16(mx0, mx1));
+        fold(mn, mx, 8, vmin, vmax);
+    }
+    return minmax_generic(v + i, n - i, vmin, vmax);
+}
+
+MINMAX_TARGET_AVX2 bool minmax_avx2(const double *v, size_t n, double &vmin, double &vmax)
+{
+    __m256d mn0 = _mm256_set1_pd(std::numeric_limits<double>::infinity());
+    __m256d mx0 = _mm256_set1_pd(-std::numeric_limits<double>::infinity());
+    __m256d mn1 = mn0, mx1 = mx0;
+    __m256d nan = _mm256_setzero_pd();
+
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        const __m256d a = _mm256_loadu_pd(v + i);
+        const __m256d b = _mm256_loadu_pd(v + i + 4);
+        mn0 = _mm256_min_pd(a, mn0);
+        mx0 = _mm256_max_pd(a, mx0);
+        mn1 = _mm256_min_pd(b, mn1);
+        mx1 = _mm256_max_pd(b, mx1);
+        nan = _mm256_or_pd(nan, _mm256_cmp_pd(a, b, _CMP_UNORD_Q));
+    }
+
+    double mn[4], mx[4];
+    _mm256_storeu_pd(mn, _mm256_min_pd(mn0, mn1));
+    _mm256_storeu_pd(mx, _mm256_max_pd(mx0, mx1));
+    fold(mn, mx, 4, vmin, vmax);
+
+    const bool hasNaN = _mm256_movemask_pd(nan) != 0;
+    return minmax_generic(v + i, n - i, vmin, vmax) || hasNaN;
+}
+
+MINMAX_TARGET_AVX2 bool minmax_avx2(const float *v, size_t n, double &vmin, double &vmax)
+{
+    __m256 mn0 = _mm256_set1_ps(std::numeric_limits<float>::infinity());
+    __m256 mx0 = _mm256_set1_ps(-std::numeric_limits<float>::infinity());
+    __m256 mn1 = mn0, mx1 = mx0;
+    __m256 nan = _mm256_setzero_ps();
+
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        const __m256 a = _mm256_loadu_ps(v + i);
+        const __m256 b = _mm256_loadu_ps(v + i + 8);
+        mn0 = _mm256_min_ps(a, mn0);
+        mx0 = _mm256_max_ps(a, mx0);
+        mn1 = _mm256_min_ps(b, mn1);
+        mx1 = _mm256_max_ps(b, mx1);
+        nan = _mm256_or_ps(nan, _mm256_cmp_ps(a, b, _CMP_UNORD_Q));
+    }
+
+    float mn[8], mx[8];
+    _mm256_storeu_ps(mn, _mm256_min_ps(mn0, mn1));
+    _mm256_storeu_ps(mx, _mm256_max_ps(mx0, mx1));
+    fold(mn, mx, 8, vmin, vmax);
+
+    const bool hasNaN = _mm256_movemask_ps(nan) != 0;
+    return minmax_generic(v + i, n - i, vmin, vmax) || hasNaN;
+}
+
+MINMAX_TARGET_AVX2 bool minmax_avx2(const qint32 *v, size_t n, double &vmin, double &vmax)
+{
+    __m256i mn0 = _mm256_set1_epi32(std::numeric_limits<qint32>::max());
+    __m256i mx0 = _mm256_set1_epi32(std::numeric_limits<qint32>::min());
+    __m256i mn1 = mn0, mx1 = mx0;
+
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(v + i));
+        const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(v + i + 8));
+        mn0 = _mm256_min_epi32(a, mn0);
+        mx0 = _mm256_max_epi32(a, mx0);
+        mn1 = _mm256_min_epi32(b, mn1);
+        mx1 = _mm256_max_epi32(b, mx1);
+    }
+
+    if (i)
+    {
+        qint32 mn[8], mx[8];
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(mn), _mm256_min_epi32(mn0, mn1));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(mx), _mm256_max_epi32(mx0, mx1));
+        fold(mn, mx, 8, vmin, vmax);
+    }
+    return minmax_generic(v + i, n - i, vmin, vmax);
+}
+
+MINMAX_TARGET_AVX2 bool minmax_avx2(const qint16 *v, size_t n, double &vmin, double &vmax)
+{
+    __m256i mn0 = _mm256_set1_epi16(std::numeric_limits<qint16>::max());
+    __m256i mx0 = _mm256_set1_epi16(std::numeric_limits<qint16>::min());
+    __m256i mn1 = mn0, mx1 = mx0;
+
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32)
+    {
+        const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(v + i));
+        const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(v + i + 16));
+        mn0 = _mm256_min_epi16(a, mn0);
+        mx0 = _mm256_max_epi16(a, mx0);
+        mn1 = _mm256_min_epi16(b, mn1);
+        mx1 = _mm256_max_epi16(b, mx1);
+    }
+
+    if (i)
+    {
+        qint16 mn[16], mx[16];
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(mn), _mm256_min_epi16(mn0, mn1));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(mx), _mm256_max_epi16(mx0, mx1));
+        fold(mn, mx, 16, vmin, vmax);
+    }
+    return minmax_generic(v + i, n - i, vmin, vmax);
+}
+
+bool cpuHasAvx2()
+{
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+    __cpuid(info, 1);
+    const bool osxsave = info[2] & (1 << 27);
+    const bool avx = info[2] & (1 << 28);
+    if (!osxsave || !avx || (_xgetbv(0) & 6) != 6)
+        return false;
+    __cpuidex(info, 7, 0);
+    return info[1] & (1 << 5);
+#else
+    return false;
+#endif
+}
+
+#endif // MINMAX_X86
+
+struct Dispatch
+{
+    bool (*d)(const double *, size_t, double &, double &);
+    bool (*f)(const float *, size_t, double &, double &);
+    bool (*i)(const qint32 *, size_t, double &, double &);
+    bool (*s)(const qint16 *, size_t, double &, double &);
+    const char *isa;
+};
+
+const Dispatch &dispatch()
+{
+    static const Dispatch table = []() -> Dispatch {
+#ifdef MINMAX_X86
+        if (cpuHasAvx2())
+            return {minmax_avx2, minmax_avx2, minmax_avx2, minmax_avx2, "avx2"};
+        return {minmax_sse2, minmax_sse2, minmax_sse2, minmax_sse2, "sse2"};
+#else
+        return {minmax_generic<double>,
+                minmax_generic<float>,
+                minmax_generic<qint32>,
+                minmax_generic<qint16>,
+                "generic"};
+#endif
+    }();
+    return table;
+}
+
+} // namespace
+
+bool MinMaxKernel::reduce(const double *v, size_t n, double &vmin, double &vmax)
+{
+    return dispatch().d(v, n, vmin, vmax);
+}
+
+bool MinMaxKernel::reduce(const float *v, size_t n, double &vmin, double &vmax)
+{
+    return dispatch().f(v, n, vmin, vmax);
+}
+
+bool MinMaxKernel::reduce(const qint32 *v, size_t n, double &vmin, double &vmax)
+{
+    return dispatch().i(v, n, vmin, vmax);
+}
+
+bool MinMaxKernel::reduce(const qint16 *v, size_t n, double &vmin, double &vmax)
+{
+    return dispatch().s(v, n, vmin, vmax);
+}
+
+const char *MinMaxKernel::isa()
+{
+    return dispatch().isa;
+}
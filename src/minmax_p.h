@@ -0,0 +1,47 @@
+#ifndef _MINMAX_P_H_
+#define _MINMAX_P_H_
+
+#include <QtGlobal>
+
+#include <cstddef>
+
+// Vectorized min/max reductions over contiguous data (minmax.cpp)
+struct MinMaxKernel
+{
+    // Fold the elements of v[0, n) into [vmin, vmax]. NaN elements are
+    // skipped, the return value tells whether any were found.
+    // SSE2 or AVX2 code paths are selected at runtime.
+    static bool reduce(const double *v, size_t n, double &vmin, double &vmax);
+    static bool reduce(const float *v, size_t n, double &vmin, double &vmax);
+    static bool reduce(const qint32 *v, size_t n, double &vmin, double &vmax);
+    static bool reduce(const qint16 *v, size_t n, double &vmin, double &vmax);
+    // name of the selected code path: "avx2", "sse2" or "generic"
+    static const char *isa();
+};
+
+// Fold v[from, to) into [vmin, vmax], using MinMaxKernel if v has
+// contiguous double, float, qint32 or qint16 storage
+template <class V_>
+inline auto minMaxOf(const V_ &v, int from, int to, double &vmin, double &vmax, int)
+    -> decltype(MinMaxKernel::reduce(v.data(), size_t(), vmin, vmax))
+{
+    return MinMaxKernel::reduce(v.data() + from, size_t(to - from), vmin, vmax);
+}
+template <class V_>
+inline bool minMaxOf(const V_ &v, int from, int to, double &vmin, double &vmax, long)
+{
+    bool nan = false;
+    for (int i = from; i < to; ++i)
+    {
+        const double x = v[i];
+        if (x < vmin)
+            vmin = x;
+        if (x > vmax)
+            vmax = x;
+        if (x != x)
+            nan = true;
+    }
+    return nan;
+}
+
+#endif // _MINMAX_P_H_
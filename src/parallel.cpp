@@ -0,0 +1,97 @@
+#include "qmatplotwidget.h"
+#include "parallel_p.h"
+
+#include <QRunnable>
+#include <QSemaphore>
+#include <QThreadPool>
+
+#include <atomic>
+
+namespace {
+
+std::atomic<int> threshold{1 << 20};
+std::atomic<QThreadPool *> pool{nullptr};
+
+// a task of parallelFor(), deleted by the pool once run
+// (QThreadPool::tryStart() takes a std::function only from Qt 5.15)
+class Task : public QRunnable
+{
+public:
+    explicit Task(const std::function<void()> &fn)
+        : fn_(fn)
+    {
+    }
+    void run() override { fn_(); }
+
+private:
+    std::function<void()> fn_;
+};
+
+} // namespace
+
+int QMatPlotWidget::parallelThreshold()
+{
+    return threshold.load(std::memory_order_relaxed);
+}
+
+QThreadPool *QMatPlotWidget::parallelPool()
+{
+    QThreadPool *p = pool.load(std::memory_order_acquire);
+    return p ? p : QThreadPool::globalInstance();
+}
+
+void QMatPlotWidget::setParallelThreshold(int n)
+{
+    threshold.store(n, std::memory_order_relaxed);
+}
+
+void QMatPlotWidget::setParallelPool(QThreadPool *p)
+{
+    pool.store(p, std::memory_order_release);
+}
+
+int parallelTasks(int n, int grain)
+{
+    const int t = QMatPlotWidget::parallelThreshold();
+    if (t <= 0 || n < t)
+        return 1;
+    const int chunks = n / std::max(grain, 1);
+    return std::max(1, std::min(chunks, QMatPlotWidget::parallelPool()->maxThreadCount()));
+}
+
+void parallelFor(int tasks, int n, int grain, const std::function<void(int, int, int)> &fn)
+{
+    if (tasks <= 1)
+    {
+        fn(0, 0, n);
+        return;
+    }
+
+    // task bounds, rounded to multiples of grain
+    grain = std::max(grain, 1);
+    auto bound = [=](int t) {
+        if (t == tasks)
+            return n;
+        const qint64 b = qint64(n) * t / tasks;
+        return int(b - b % grain);
+    };
+
+    // tasks that find no free thread run here, so that parallelFor()
+    // can be called from the pool itself without deadlock
+    QThreadPool *p = QMatPlotWidget::parallelPool();
+    QSemaphore done;
+    for (int t = 1; t < tasks; ++t)
+    {
+        Task *task = new Task([&, t] {
+            fn(t, bound(t), bound(t + 1));
+            done.release();
+        });
+        if (!p->tryStart(task))
+        {
+            task->run();
+            delete task;
+        }
+    }
+    fn(0, 0, bound(1));
+    done.acquire(tasks - 1);
+}
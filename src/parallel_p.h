@@ -0,0 +1,23 @@
+#ifndef _PARALLEL_P_H_
+#define _PARALLEL_P_H_
+
+#include <functional>
+
+/*
+ * Parallel preprocessing of large series and images, on the threads of
+ * QMatPlotWidget::parallelPool() (parallel.cpp)
+ */
+
+// Number of tasks that parallelFor() splits n elements into, for at
+// least grain elements per task: 1 below QMatPlotWidget::parallelThreshold(),
+// at most the thread count of QMatPlotWidget::parallelPool()
+int parallelTasks(int n, int grain);
+
+// Call fn(t, from, to) for the tasks t in [0, tasks), over consecutive
+// ranges [from, to) covering [0, n) with bounds at multiples of grain,
+// and return when all calls are done. Tasks run on the parallel pool
+// as long as it has free threads, the others on the calling thread.
+// fn may be called from several threads at once.
+void parallelFor(int tasks, int n, int grain, const std::function<void(int, int, int)> &fn);
+
+#endif // _PARALLEL_P_H_
@@ -27,6 +27,7 @@ QMatPlotWidget::QMatPlotWidget(QWidget *parent)
     , backend_(new QwtBackend(this))
     , axisScaleX_(Linear)
     , axisScaleY_(Linear)
+    , colorScale_(Linear)
     , grid_on_(false)
     , colorOrder_(defaultColorOrder())
     , colorIndex_(0)
@@ -39,6 +40,8 @@ QMatPlotWidget::QMatPlotWidget(QWidget *parent)
 
     backend_->setGrid(grid_on_);
 
+    qRegisterMetaType<QMatPlotWidget::RenderStats>();
+
     // colorOrder_ << Qt::blue
     //             << Qt::red
     //             << Qt::darkGreen
@@ -116,6 +119,14 @@ void QMatPlotWidget::setAxisScaleY(AxisScale sc)
     backend_->setAxisScaleY(sc);
     axisScaleY_ = sc;
 }
+// Linear or Log mapping of the values of scaled images (imagesc)
+// to the color map; Time is the same as Linear
+void QMatPlotWidget::setColorScale(AxisScale sc)
+{
+    if (sc==colorScale_) return;
+    backend_->setColorScale(sc);
+    colorScale_ = sc;
+}
 void QMatPlotWidget::setGrid(bool on)
 {
     if (grid_on_==on) return;
@@ -152,7 +163,7 @@ void QMatPlotWidget::setColorMap(const QVector<QRgb> &c)
     colorMap_ = c;
 }
 
-void QMatPlotWidget::__plot__(AbstractDataSeriesAdaptor *data,
+int QMatPlotWidget::__plot__(AbstractDataSeriesAdaptor *data,
                               const QString &attr,
                               const QColor &clr)
 {
@@ -168,10 +179,10 @@ void QMatPlotWidget::__plot__(AbstractDataSeriesAdaptor *data,
 
     opt.clr = plotClr;
 
-    backend_->plot(data, opt);
+    return backend_->plot(data, opt);
 }
 
-void QMatPlotWidget::__errorbar__(AbstractErrorBarAdaptor *d, const QString &attr, const QColor &clr)
+int QMatPlotWidget::__errorbar__(AbstractErrorBarAdaptor *d, const QString &attr, const QColor &clr)
 {
     LineSpec opt = LineSpec::fromMatlabLineSpec(attr);
 
@@ -185,12 +196,57 @@ void QMatPlotWidget::__errorbar__(AbstractErrorBarAdaptor *d, const QString &att
 
     opt.clr = plotClr;
 
-    backend_->errorbar(d, opt);
+    return backend_->errorbar(d, opt);
 }
 
-void QMatPlotWidget::__image__(AbstractImageAdaptor *d, bool scale)
+int QMatPlotWidget::__scatter__(AbstractDataSeriesAdaptor *d,
+                                 const QString &attr,
+                                 const QColor &clr)
 {
-    backend_->image(d, scale, colorMap_);
+    LineSpec opt = LineSpec::fromMatlabLineSpec(attr);
+    if (opt.markerStyle == LineSpec::nMarkers)
+        opt.markerStyle = 1; // 'o'
+
+    QColor plotClr;
+    if (opt.clr.isValid())
+        plotClr = opt.clr;
+    else if (clr.isValid())
+        plotClr = clr;
+    else
+        plotClr = QColor(colorOrder_[colorIndex_++ % colorOrder_.size()]);
+
+    opt.clr = plotClr;
+
+    return backend_->scatter(d, opt, colorMap_);
+}
+
+int QMatPlotWidget::__image__(AbstractImageAdaptor *d, bool scale)
+{
+    return backend_->image(d, scale, colorMap_);
+}
+
+int QMatPlotWidget::__hist2d__(AbstractDataSeriesAdaptor *points, int nbinsx, int nbinsy)
+{
+    return backend_->image(new Histogram2D(points, nbinsx, nbinsy), true, colorMap_);
+}
+
+PlotHandle QMatPlotWidget::waterfall(int columns,
+                                     int depth,
+                                     const QPointF &clim,
+                                     const QPointF &xlim)
+{
+    const QPointF x = xlim.isNull() ? QPointF(0, columns) : xlim;
+    return PlotHandle(this,
+                      backend_->waterfall(columns, depth, x, clim, colorMap_),
+                      PlotHandle::Waterfall);
+}
+
+StreamWriter QMatPlotWidget::stream(int capacity, const QString &attr, const QColor &clr)
+{
+    std::shared_ptr<StreamingSeries> s = std::make_shared<StreamingSeries>(capacity);
+    connect(s->notifier(), &StreamNotifier::updated, this, &QMatPlotWidget::replot);
+    __plot__(new StreamAdaptor(s), attr, clr);
+    return StreamWriter(s);
 }
 
 void QMatPlotWidget::clear()
@@ -199,10 +255,104 @@ void QMatPlotWidget::clear()
     colorIndex_ = 0;
     replot();
 }
+// Replots are not immediate: any number of requests is merged into
+// one frame, rendered at most once per display refresh (or maxFps).
 void QMatPlotWidget::replot()
 {
     backend_->replot();
 }
+// Render a pending replot without waiting for the next frame
+void QMatPlotWidget::replotNow()
+{
+    backend_->replotNow();
+}
+// Frame rate limit, 0 = display refresh rate
+double QMatPlotWidget::maxFps() const
+{
+    return backend_->maxFps();
+}
+void QMatPlotWidget::setMaxFps(double fps)
+{
+    backend_->setMaxFps(fps);
+}
+// Number of replot requests merged into another frame
+quint64 QMatPlotWidget::mergedReplots() const
+{
+    return backend_->mergedReplots();
+}
+// Number of frames rendered
+quint64 QMatPlotWidget::frameCount() const
+{
+    return backend_->frameCount();
+}
+// Image renders served from the render cache / rasterized again
+quint64 QMatPlotWidget::imageCacheHits() const
+{
+    return backend_->imageCacheHitCount();
+}
+quint64 QMatPlotWidget::imageCacheMisses() const
+{
+    return backend_->imageCacheMissCount();
+}
+// Render the canvas in a worker thread.
+// Frames are rendered from a copy of the plotted data, taken when the
+// replot starts, and only blitted by the GUI thread. The copy shares
+// the data of implicitly shared containers (QVector, QList, see
+// ImplicitlyShared) and of streams, copied once per drain. Frames
+// plotting other containers, DataView and raw pointers included, are
+// drawn by the GUI thread as without threaded rendering, since the
+// caller may modify that memory in place at any time.
+bool QMatPlotWidget::threadedRendering() const
+{
+    return backend_->threadedRendering();
+}
+void QMatPlotWidget::setThreadedRendering(bool on)
+{
+    backend_->setThreadedRendering(on);
+}
+// Threaded frames superseded by a newer one before they were rendered
+quint64 QMatPlotWidget::droppedFrames() const
+{
+    return backend_->droppedFrames();
+}
+// Frame times, time spent in each stage of the last frame and counters
+QMatPlotWidget::RenderStats QMatPlotWidget::renderStats() const
+{
+    return backend_->renderStats();
+}
+// Period of renderStatsUpdated() in ms, 0 = never (default). The
+// signal is skipped for the periods in which no frame was rendered.
+// Per item draw times are only measured while the period is > 0.
+int QMatPlotWidget::statsInterval() const
+{
+    return backend_->statsInterval();
+}
+void QMatPlotWidget::setStatsInterval(int ms)
+{
+    backend_->setStatsInterval(ms);
+}
+// Start an update transaction (may be nested).
+// Until the matching endUpdate(), adding items or changing limits,
+// labels and scales neither re-layouts nor renders the plot; the axes
+// are autoscaled and the plot is replotted once when it ends.
+void QMatPlotWidget::beginUpdate()
+{
+    backend_->beginUpdate();
+}
+void QMatPlotWidget::endUpdate()
+{
+    backend_->endUpdate();
+}
+bool QMatPlotWidget::isUpdating() const
+{
+    return backend_->isUpdating();
+}
+// Discard all cached data (extents, image copies) and replot.
+// Call after modifying data plotted without copy (see DataView).
+void QMatPlotWidget::dataChanged()
+{
+    backend_->dataChanged();
+}
 
 QSize QMatPlotWidget::minimumSizeHint() const
 {
@@ -450,3 +600,138 @@ void QMatPlotAxisDlg::onAutoScale(bool on)
     edtMinVal->setEnabled(!on);
     edtMaxVal->setEnabled(!on);
 }
+
+/*---- PlotHandle -------*/
+
+bool PlotHandle::isValid() const
+{
+    return w_ && w_->backend_->hasItem(id_);
+}
+
+AbstractDataSeriesAdaptor *PlotHandle::seriesAdaptor() const
+{
+    return (kind_ == Line || kind_ == Stairs || kind_ == Scatter) && w_
+               ? w_->backend_->seriesAdaptor(id_)
+               : nullptr;
+}
+
+AbstractErrorBarAdaptor *PlotHandle::errorBarAdaptor() const
+{
+    return kind_ == ErrorBar && w_ ? w_->backend_->errorBarAdaptor(id_) : nullptr;
+}
+
+AbstractImageAdaptor *PlotHandle::imageAdaptor() const
+{
+    return kind_ == Image && w_ ? w_->backend_->imageAdaptor(id_) : nullptr;
+}
+
+bool PlotHandle::replace(AbstractDataSeriesAdaptor *d)
+{
+    if (!isValid())
+    {
+        delete d;
+        return false;
+    }
+    w_->backend_->setSeriesAdaptor(id_, d);
+    return true;
+}
+
+bool PlotHandle::replace(AbstractErrorBarAdaptor *d)
+{
+    if (!isValid())
+    {
+        delete d;
+        return false;
+    }
+    w_->backend_->setErrorBarAdaptor(id_, d);
+    return true;
+}
+
+bool PlotHandle::dataChanged()
+{
+    if (!isValid())
+        return false;
+    w_->backend_->itemDataChanged(id_);
+    return true;
+}
+
+bool PlotHandle::setSortedX(bool on)
+{
+    AbstractDataSeriesAdaptor *d = seriesAdaptor();
+    if (!d)
+        return false;
+    d->xSorted = on;
+    return dataChanged();
+}
+
+bool PlotHandle::setXScale(double scale, double offset)
+{
+    if (AbstractDataSeriesAdaptor *d = seriesAdaptor())
+        d->xScale = SampleScale{scale, offset};
+    else if (AbstractErrorBarAdaptor *e = errorBarAdaptor())
+        e->xScale = SampleScale{scale, offset};
+    else
+        return false;
+    return dataChanged();
+}
+
+bool PlotHandle::setYScale(double scale, double offset)
+{
+    if (AbstractDataSeriesAdaptor *d = seriesAdaptor())
+        d->yScale = SampleScale{scale, offset};
+    else if (AbstractErrorBarAdaptor *e = errorBarAdaptor())
+        e->yScale = SampleScale{scale, offset};
+    else
+        return false;
+    return dataChanged();
+}
+
+bool PlotHandle::appendRow(const double *z, int n)
+{
+    if (kind_ != Waterfall || !isValid())
+        return false;
+    return w_->backend_->appendRow(id_, z, n);
+}
+
+bool PlotHandle::setClim(const QPointF &clim)
+{
+    if (kind_ != Waterfall || !isValid())
+        return false;
+    w_->backend_->setClim(id_, clim);
+    return true;
+}
+
+bool PlotHandle::setLineSpec(const QString &attr, const QColor &clr)
+{
+    if (!isValid())
+        return false;
+    QMatPlotWidget::LineSpec opt = QMatPlotWidget::LineSpec::fromMatlabLineSpec(attr);
+    if (!opt.clr.isValid())
+        opt.clr = clr;
+    w_->backend_->setItemStyle(id_, opt);
+    return true;
+}
+
+bool PlotHandle::setColor(const QColor &clr)
+{
+    if (!isValid())
+        return false;
+    w_->backend_->setItemColor(id_, clr);
+    return true;
+}
+
+bool PlotHandle::setVisible(bool on)
+{
+    if (!isValid())
+        return false;
+    w_->backend_->setItemVisible(id_, on);
+    return true;
+}
+
+bool PlotHandle::remove()
+{
+    if (!isValid())
+        return false;
+    w_->backend_->removeItem(id_);
+    return true;
+}
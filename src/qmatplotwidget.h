@@ -1,18 +1,66 @@
 #ifndef _QMATPLOTWIDGET_H_
 #define _QMATPLOTWIDGET_H_
 
+#include "qmatplotwidget_adaptors.h"
 #include "qmatplotwidget_export.h"
 
+#include <QMap>
 #include <QPointF>
+#include <QPointer>
 #include <QRectF>
 #include <QVector>
 #include <QWidget>
 #include <QDialog>
 
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#if __has_include(<version>)
+#include <version>
+#endif
+#ifdef __cpp_lib_span
+#include <span>
+#endif
+
 class QMenu;
-struct AbstractDataSeriesAdaptor;
-struct AbstractErrorBarAdaptor;
-struct AbstractImageAdaptor;
+class QThreadPool;
+class StreamingSeries;
+class PlotHandle;
+
+// Writer end of a streaming series, see QMatPlotWidget::stream().
+//
+// append() may be called from one thread at a time, typically an
+// acquisition thread, and never blocks: samples go through a lock-free
+// single-producer/single-consumer queue. The widget moves queued samples
+// into the plotted history on the GUI thread before each replot, so the
+// drawn data is always a consistent snapshot.
+// The writer remains usable after the series has been removed from the
+// plot; samples are then discarded.
+class QMATPLOTWIDGET_EXPORT StreamWriter
+{
+public:
+    StreamWriter() {}
+
+    // false for default constructed writers and removed series
+    bool isValid() const;
+    // queue n samples, return the number accepted: less than n if the
+    // queue is full because the GUI thread did not keep up
+    int append(const double *x, const double *y, int n);
+    int append(double x, double y) { return append(&x, &y, 1); }
+    // number of samples rejected so far because the queue was full
+    quint64 dropped() const;
+
+private:
+    friend class QMatPlotWidget;
+    explicit StreamWriter(const std::shared_ptr<StreamingSeries> &s)
+        : d_(s)
+    {
+    }
+    std::shared_ptr<StreamingSeries> d_;
+};
 
 class QMATPLOTWIDGET_EXPORT QMatPlotWidget : public QWidget
 {
@@ -25,9 +73,13 @@ class QMATPLOTWIDGET_EXPORT QMatPlotWidget : public QWidget
     Q_PROPERTY(bool autoScaleY READ autoScaleY WRITE setAutoScaleY)
     Q_PROPERTY(AxisScale axisScaleX READ axisScaleX WRITE setAxisScaleX)
     Q_PROPERTY(AxisScale axisScaleY READ axisScaleY WRITE setAxisScaleY)
+    Q_PROPERTY(AxisScale colorScale READ colorScale WRITE setColorScale)
     Q_PROPERTY(bool grid READ grid WRITE setGrid)
     Q_PROPERTY(QPointF xlim READ xlim WRITE setXlim)
     Q_PROPERTY(QPointF ylim READ ylim WRITE setYlim)
+    Q_PROPERTY(double maxFps READ maxFps WRITE setMaxFps)
+    Q_PROPERTY(bool threadedRendering READ threadedRendering WRITE setThreadedRendering)
+    Q_PROPERTY(int statsInterval READ statsInterval WRITE setStatsInterval)
     Q_PROPERTY(QVector<QRgb> colorOrder READ colorOrder WRITE setColorOrder)
     Q_PROPERTY(QVector<QRgb> colorMap READ colorMap WRITE setColorMap)
 
@@ -61,6 +113,57 @@ public:
         static LineSpec fromMatlabLineSpec(const QString &attr);
     };
 
+    // Scoped update transaction, see beginUpdate()
+    class UpdateGuard
+    {
+    public:
+        explicit UpdateGuard(QMatPlotWidget *w)
+            : w_(w)
+        {
+            w_->beginUpdate();
+        }
+        ~UpdateGuard() { w_->endUpdate(); }
+        UpdateGuard(const UpdateGuard &) = delete;
+        UpdateGuard &operator=(const UpdateGuard &) = delete;
+
+    private:
+        QMatPlotWidget *w_;
+    };
+
+    // Rendering statistics, see renderStats(). Times are in ms.
+    struct RenderStats
+    {
+        // frame times and rate are over the last FrameWindow frames
+        static const int FrameWindow = 128;
+
+        quint64 replotsRequested{0}; // replot() calls, including autoReplot
+        quint64 replotsPerformed{0}; // frames rendered
+        quint64 framesDropped{0};    // see droppedFrames()
+        double lastFrameTime{0.};
+        double meanFrameTime{0.};
+        double p50FrameTime{0.};
+        double p95FrameTime{0.};
+        double p99FrameTime{0.};
+        double maxFrameTime{0.};
+        double fps{0.};
+
+        // stages of the last frame; with threaded rendering, draw is
+        // the time of the render thread and blit the time of the GUI
+        // thread to show the frame
+        double autoscaleTime{0.};
+        double layoutTime{0.};
+        double drawTime{0.};
+        double blitTime{0.};
+        // by item, see PlotHandle::id(); measured only while
+        // statsInterval() > 0
+        QMap<int, double> itemDrawTime;
+
+        // samples of the drawn series, and points actually drawn after
+        // clipping and decimation, in the last frame
+        quint64 pointsSubmitted{0};
+        quint64 pointsDrawn{0};
+    };
+
 public:
     explicit QMatPlotWidget(QWidget *parent = 0);
     virtual ~QMatPlotWidget();
@@ -73,6 +176,7 @@ public:
     bool autoScaleY() const;
     AxisScale axisScaleX() const { return axisScaleX_; }
     AxisScale axisScaleY() const { return axisScaleY_; }
+    AxisScale colorScale() const { return colorScale_; }
     bool timeScaleX() const { return axisScaleX_ == Time; }
     bool timeScaleY() const { return axisScaleY_ == Time; }
     bool logScaleX() const { return axisScaleX_ == Log; }
@@ -84,10 +188,31 @@ public:
     QPointF ylim() const;
     QVector<QRgb> colorOrder() const { return colorOrder_; }
     QVector<QRgb> colorMap() const { return colorMap_; }
+    double maxFps() const;
+    quint64 mergedReplots() const;
+    quint64 frameCount() const;
+    quint64 imageCacheHits() const;
+    quint64 imageCacheMisses() const;
+    bool threadedRendering() const;
+    quint64 droppedFrames() const;
+    RenderStats renderStats() const;
+    int statsInterval() const;
+    bool isUpdating() const;
 
     static QVector<QRgb> colorMap(ColorMapType t, int n = 64);
     static QVector<QRgb> defaultColorOrder();
 
+    // Preprocessing of series and images of at least parallelThreshold()
+    // samples (extents, hist2d binning) is split over the threads of
+    // parallelPool(). Shared by all widgets.
+    static int parallelThreshold();
+    static QThreadPool *parallelPool();
+    // n <= 0 disables it, 1 << 20 by default
+    static void setParallelThreshold(int n);
+    // pool kept alive by the caller; nullptr for the default,
+    // QThreadPool::globalInstance()
+    static void setParallelPool(QThreadPool *pool);
+
     // setters
     void setTitle(const QString &s);
     void setXlabel(const QString &s);
@@ -97,6 +222,9 @@ public:
     void setColorOrder(const QVector<QRgb> &c);
     void setColorMap(const QVector<QRgb> &c);
     void setColorMap(ColorMapType t, int n = 64) { setColorMap(colorMap(t, n)); }
+    void setMaxFps(double fps);
+    void setThreadedRendering(bool on);
+    void setStatsInterval(int ms);
 
     // QWidget overrides
     QSize sizeHint() const override;
@@ -107,12 +235,17 @@ public:
 public slots:
     void clear();
     void replot();
+    void replotNow();
+    void dataChanged();
+    void beginUpdate();
+    void endUpdate();
 
     // slot setters
     void setAutoScaleX(bool on);
     void setAutoScaleY(bool on);
     void setAxisScaleX(AxisScale sc);
     void setAxisScaleY(AxisScale sc);
+    void setColorScale(AxisScale sc);
     void setGrid(bool on);
 
     // helpers
@@ -126,70 +259,207 @@ public slots:
 
     void onAxisClicked(int axisid, const QPoint &pos);
 
+signals:
+    // emitted after each rendered frame
+    void frameRendered();
+    // emitted every statsInterval() ms, if frames were rendered
+    void renderStatsUpdated(const QMatPlotWidget::RenderStats &stats);
+
 public:
     template <class VectorType>
-    void plot(const VectorType &x, const VectorType &y,
-              const QString &attr = QString(), const QColor &clr = QColor());
+    PlotHandle plot(const VectorType &x, const VectorType &y,
+                    const QString &attr = QString(), const QColor &clr = QColor());
+    template <class VectorType>
+    PlotHandle plot(const VectorType &y,
+                    const QString &attr = QString(), const QColor &clr = QColor());
+    template <class VectorType>
+    PlotHandle stairs(const VectorType &x,
+                      const VectorType &y,
+                      const QString &attr = QString(),
+                      const QColor &clr = QColor());
     template <class VectorType>
-    void plot(const VectorType &y,
-              const QString &attr = QString(), const QColor &clr = QColor());
+    PlotHandle stairs(const VectorType &y,
+                      const QString &attr = QString(),
+                      const QColor &clr = QColor());
+
+    // Scatter plot with markers of area sz (in pixels^2, as in MATLAB in
+    // points^2) and either a single color or one value per point in c,
+    // mapped to the color map over the range of c. The marker is taken
+    // from attr, 'o' by default.
     template <class VectorType>
-    void stairs(const VectorType &x,
-                const VectorType &y,
-                const QString &attr = QString(),
-                const QColor &clr = QColor());
+    PlotHandle scatter(const VectorType &x,
+                       const VectorType &y,
+                       double sz = 36.,
+                       const QString &attr = QString(),
+                       const QColor &clr = QColor());
     template <class VectorType>
-    void stairs(const VectorType &y, const QString &attr = QString(), const QColor &clr = QColor());
+    PlotHandle scatter(const VectorType &x,
+                       const VectorType &y,
+                       const VectorType &sz,
+                       const QString &attr = QString(),
+                       const QColor &clr = QColor());
+    template <class VectorType>
+    PlotHandle scatter(const VectorType &x,
+                       const VectorType &y,
+                       double sz,
+                       const VectorType &c,
+                       const QString &attr = QString());
+    template <class VectorType>
+    PlotHandle scatter(const VectorType &x,
+                       const VectorType &y,
+                       const VectorType &sz,
+                       const VectorType &c,
+                       const QString &attr = QString());
 
     template <class VectorType>
-    void errorbar(const VectorType &y,
-                  const VectorType &dy,
-                  const QString &attr = QString(),
-                  const QColor &clr = QColor());
+    PlotHandle errorbar(const VectorType &y,
+                        const VectorType &dy,
+                        const QString &attr = QString(),
+                        const QColor &clr = QColor());
     template <class VectorType>
-    void errorbar(const VectorType &x,
-                  const VectorType &y,
-                  const VectorType &dy,
-                  const QString &attr = QString(),
-                  const QColor &clr = QColor());
+    PlotHandle errorbar(const VectorType &x,
+                        const VectorType &y,
+                        const VectorType &dy,
+                        const QString &attr = QString(),
+                        const QColor &clr = QColor());
     template <class VectorType>
-    void errorbar(const VectorType &y,
-                  double dy,
-                  const QString &attr = QString(),
-                  const QColor &clr = QColor());
+    PlotHandle errorbar(const VectorType &y,
+                        double dy,
+                        const QString &attr = QString(),
+                        const QColor &clr = QColor());
     template <class VectorType>
-    void errorbar(const VectorType &x,
-                  const VectorType &y,
-                  double dy,
-                  const QString &attr = QString(),
-                  const QColor &clr = QColor());
+    PlotHandle errorbar(const VectorType &x,
+                        const VectorType &y,
+                        double dy,
+                        const QString &attr = QString(),
+                        const QColor &clr = QColor());
     template <class VectorType>
-    void errorbar(const VectorType &x,
-                  const VectorType &y,
-                  const VectorType &dym,
-                  const VectorType &dyp,
-                  const QString &attr = QString(),
-                  const QColor &clr = QColor());
+    PlotHandle errorbar(const VectorType &x,
+                        const VectorType &y,
+                        const VectorType &dym,
+                        const VectorType &dyp,
+                        const QString &attr = QString(),
+                        const QColor &clr = QColor());
 
     template <class VectorType>
-    void image(const VectorType &x, const VectorType &y, const VectorType &z, int columns);
+    PlotHandle image(const VectorType &x, const VectorType &y, const VectorType &z, int columns);
     template <class VectorType>
-    void image(const VectorType &z, int columns);
+    PlotHandle image(const VectorType &z, int columns);
 
     template <class VectorType>
-    void imagesc(const VectorType &x, const VectorType &y, const VectorType &z, int columns);
+    PlotHandle imagesc(const VectorType &x, const VectorType &y, const VectorType &z, int columns);
+    template <class VectorType>
+    PlotHandle imagesc(const VectorType &z, int columns);
+
+    // 2-D histogram (density plot) of the points (x, y): the counts of
+    // nbinsx x nbinsy bins drawn as an image with the color map, empty
+    // bins transparent. The bins span the visible part of the data and
+    // are counted again from x and y, not copied, on zoom and pan.
     template <class VectorType>
-    void imagesc(const VectorType &z, int columns);
+    PlotHandle hist2d(const VectorType &x,
+                      const VectorType &y,
+                      int nbinsx = 100,
+                      int nbinsy = 100);
+
+    // Scrolling image ("waterfall") of the last `depth` rows of `columns`
+    // values, fed with PlotHandle::appendRow(). The newest row is drawn
+    // at the top (y = depth) and older rows scroll down. The columns span
+    // xlim, [0, columns] by default. Values are mapped to the color map
+    // over clim, see also PlotHandle::setClim().
+    PlotHandle waterfall(int columns,
+                         int depth,
+                         const QPointF &clim,
+                         const QPointF &xlim = QPointF());
+
+    // Streaming series keeping the last `capacity` samples, fed through
+    // the returned writer (see StreamWriter)
+    StreamWriter stream(int capacity,
+                        const QString &attr = QString(),
+                        const QColor &clr = QColor());
+
+    // Non-owning overloads: the data are not copied, see DataView.
+    // Samples of type T = float, qint32 or qint16 take less memory than
+    // doubles and are read as stored, see PlotHandle::setYScale().
+    template <class T>
+    PlotHandle plot(const T *x,
+                    const T *y,
+                    int n,
+                    const QString &attr = QString(),
+                    const QColor &clr = QColor());
+    template <class T>
+    PlotHandle plot(const T *y,
+                    int n,
+                    const QString &attr = QString(),
+                    const QColor &clr = QColor());
+    template <class T>
+    PlotHandle stairs(const T *x,
+                      const T *y,
+                      int n,
+                      const QString &attr = QString(),
+                      const QColor &clr = QColor());
+    template <class T>
+    PlotHandle stairs(const T *y,
+                      int n,
+                      const QString &attr = QString(),
+                      const QColor &clr = QColor());
+    PlotHandle errorbar(const double *x,
+                        const double *y,
+                        const double *dy,
+                        int n,
+                        const QString &attr = QString(),
+                        const QColor &clr = QColor());
+    PlotHandle errorbar(const double *x,
+                        const double *y,
+                        double dy,
+                        int n,
+                        const QString &attr = QString(),
+                        const QColor &clr = QColor());
+    template <class T>
+    PlotHandle hist2d(const T *x, const T *y, int n, int nbinsx = 100, int nbinsy = 100);
+#ifdef __cpp_lib_span
+    PlotHandle plot(std::span<const double> x,
+                    std::span<const double> y,
+                    const QString &attr = QString(),
+                    const QColor &clr = QColor());
+    PlotHandle plot(std::span<const double> y,
+                    const QString &attr = QString(),
+                    const QColor &clr = QColor());
+    PlotHandle stairs(std::span<const double> x,
+                      std::span<const double> y,
+                      const QString &attr = QString(),
+                      const QColor &clr = QColor());
+    PlotHandle stairs(std::span<const double> y,
+                      const QString &attr = QString(),
+                      const QColor &clr = QColor());
+    PlotHandle errorbar(std::span<const double> x,
+                        std::span<const double> y,
+                        std::span<const double> dy,
+                        const QString &attr = QString(),
+                        const QColor &clr = QColor());
+    PlotHandle errorbar(std::span<const double> x,
+                        std::span<const double> y,
+                        double dy,
+                        const QString &attr = QString(),
+                        const QColor &clr = QColor());
+    PlotHandle hist2d(std::span<const double> x,
+                      std::span<const double> y,
+                      int nbinsx = 100,
+                      int nbinsy = 100);
+#endif
 
     struct Backend;
+    friend class PlotHandle;
 
 protected:
     virtual QMenu *createAxisContextMenu(int axisid);
     virtual void axisPropertyDialog(int axisid);
 
-    void __plot__(AbstractDataSeriesAdaptor *d, const QString &attr, const QColor &clr);
-    void __errorbar__(AbstractErrorBarAdaptor *d, const QString &attr, const QColor &clr);
-    void __image__(AbstractImageAdaptor *d, bool scale);
+    // add an item, return its id
+    int __plot__(AbstractDataSeriesAdaptor *d, const QString &attr, const QColor &clr);
+    int __errorbar__(AbstractErrorBarAdaptor *d, const QString &attr, const QColor &clr);
+    int __scatter__(AbstractDataSeriesAdaptor *d, const QString &attr, const QColor &clr);
+    int __image__(AbstractImageAdaptor *d, bool scale);
+    int __hist2d__(AbstractDataSeriesAdaptor *points, int nbinsx, int nbinsy);
 
 protected slots:
     void xAxisPropDlg() { axisPropertyDialog(0); }
@@ -198,7 +468,7 @@ protected slots:
 private:
     Backend *const backend_;
 
-    AxisScale axisScaleX_, axisScaleY_;
+    AxisScale axisScaleX_, axisScaleY_, colorScale_;
     bool grid_on_;
 
     QVector<QRgb> colorOrder_;
@@ -206,363 +476,685 @@ private:
     QVector<QRgb> colorMap_;
 };
 
-/*---- Templated plot functions -------*/
+// Handle to a plotted item, returned by plot(), stairs(), scatter(),
+// errorbar() and image()/imagesc().
+//
+// The data and the style of the item can be changed in place, as with
+// set(h, 'YData', y) in MATLAB, without re-creating the item.
+// If the new data have the container type of the plotted data, it is
+// assigned to the existing adaptor; otherwise setData() creates a new
+// adaptor and setYData()/setZData() fail.
+// A handle becomes invalid when its item is removed, by clear() or
+// remove(), or the widget is destroyed. Its methods then return false.
+class QMATPLOTWIDGET_EXPORT PlotHandle
+{
+public:
+    enum Kind { None, Line, Stairs, ErrorBar, Image, Waterfall, Scatter };
+
+    PlotHandle() {}
+
+    bool isValid() const;
+    Kind kind() const { return kind_; }
+    // identifies the item in QMatPlotWidget::RenderStats
+    int id() const { return id_; }
+
+    // line, stairs and scatter plots; scatter plots keep their sizes
+    // and colors, and take only the vector type they were created with
+    template <class V_>
+    bool setData(const V_ &x, const V_ &y);
+    template <class V_>
+    bool setYData(const V_ &y);
+    // errorbar plots, dy is a vector or a single value
+    template <class V_, class E_>
+    bool setData(const V_ &x, const V_ &y, const E_ &dy);
+    template <class V_, class E_>
+    bool setYData(const V_ &y, const E_ &dy);
+    // images, with the same number of columns
+    template <class V_>
+    bool setZData(const V_ &z);
+    // the data were modified in place (for data plotted without copy)
+    bool dataChanged();
+    // line and stairs plots: declare that x is non-decreasing, also
+    // after setData(), for series where it cannot be detected
+    bool setSortedX(bool on);
+    // line, stairs, scatter and error bar plots: plot the stored values
+    // v as v * scale + offset, e.g. integer ADC counts in volts. The x
+    // scale also maps the sample index of series given only y, the y
+    // scale also the error bars.
+    bool setXScale(double scale, double offset = 0.);
+    bool setYScale(double scale, double offset = 0.);
+
+    // waterfall plots: add a row of n values, false unless n is the
+    // number of columns of the waterfall
+    bool appendRow(const double *z, int n);
+    template <class V_, class = std::enable_if_t<!std::is_pointer<std::decay_t<V_>>::value>>
+    bool appendRow(const V_ &z);
+    // values mapped to the ends of the color map
+    bool setClim(const QPointF &clim);
+
+    // line style as in plot(); an invalid clr keeps the current color
+    bool setLineSpec(const QString &attr, const QColor &clr = QColor());
+    bool setColor(const QColor &clr);
+    bool setVisible(bool on);
+    bool remove();
+
+private:
+    friend class QMatPlotWidget;
+    PlotHandle(QMatPlotWidget *w, int id, Kind k)
+        : w_(w), id_(id), kind_(k)
+    {
+    }
+
+    AbstractDataSeriesAdaptor *seriesAdaptor() const;
+    AbstractErrorBarAdaptor *errorBarAdaptor() const;
+    AbstractImageAdaptor *imageAdaptor() const;
+    // replace the adaptor of the item (taking ownership)
+    bool replace(AbstractDataSeriesAdaptor *d);
+    bool replace(AbstractErrorBarAdaptor *d);
 
-struct AbstractDataSeriesAdaptor
+    QPointer<QMatPlotWidget> w_;
+    int id_{0};
+    Kind kind_{None};
+};
+
+/*---- Non-owning data views -------*/
+
+// Non-owning view of n contiguous elements of type T.
+//
+// Plotting a DataView does not copy the data. The caller keeps the memory
+// alive for as long as the plot item exists, that is until clear() is
+// called or the widget is destroyed. Memory modified in place must be
+// reported with QMatPlotWidget::dataChanged() before the next replot.
+template <class T>
+class DataView
 {
-    virtual ~AbstractDataSeriesAdaptor() {}
-    virtual int size() const = 0;
-    virtual QPointF sample(int i) const = 0;
-    virtual QRectF boundingRect() const = 0;
+    const T *p_;
+    int n_;
+
+public:
+    DataView()
+        : p_(nullptr), n_(0)
+    {
+    }
+    DataView(const T *p, int n)
+        : p_(p), n_(n)
+    {
+    }
+#ifdef __cpp_lib_span
+    DataView(std::span<const T> s)
+        : p_(s.data()), n_(int(s.size()))
+    {
+    }
+#endif
+    int size() const { return n_; }
+    const T *data() const { return p_; }
+    const T &operator[](int i) const { return p_[i]; }
 };
 
+/*---- Templated plot functions -------*/
+
 template <class V_>
-class DataSeriesAdaptor : public AbstractDataSeriesAdaptor
+class DataSeriesAdaptor : public CachedSeriesAdaptor
 {
     V_ vx;
     V_ vy;
     bool yonly_;
 
+protected:
+    void attach()
+    {
+        if (!yonly_)
+            attachChangeListener(vx, this, 0);
+        attachChangeListener(vy, this, 0);
+    }
+    void detach()
+    {
+        if (!yonly_)
+            detachChangeListener(vx, this, 0);
+        detachChangeListener(vy, this, 0);
+    }
+    QPointF storedSample(int i) const override { return QPointF(yonly_ ? i : vx[i], vy[i]); }
+    bool hasX() const override { return !yonly_; }
+
 public:
     DataSeriesAdaptor(const V_ &y)
         : vy(y), yonly_(true)
     {
+        attach();
     }
     DataSeriesAdaptor(const V_ &x, const V_ &y)
         : vx(x), vy(y), yonly_(false)
     {
+        attach();
+    }
+    DataSeriesAdaptor(const DataSeriesAdaptor &other)
+        : CachedSeriesAdaptor(other)
+        , vx(other.vx)
+        , vy(other.vy)
+        , yonly_(other.yonly_)
+    {
+        attach();
+    }
+    ~DataSeriesAdaptor() { detach(); }
+    // replace the data in place
+    void setData(const V_ &x, const V_ &y)
+    {
+        detach();
+        vx = x;
+        vy = y;
+        yonly_ = false;
+        attach();
+        invalidate();
+    }
+    void setYData(const V_ &y)
+    {
+        detach();
+        vy = y;
+        attach();
+        invalidate();
     }
-    DataSeriesAdaptor(const DataSeriesAdaptor &other) = default;
     int size() const override { return yonly_ ? vy.size() : qMin(vx.size(), vy.size()); }
     QPointF sample(int i) const override
     {
-        return yonly_ ? QPointF(i, vy[i]) : QPointF(vx[i], vy[i]);
+        return QPointF(xScale(yonly_ ? i : vx[i]), yScale(vy[i]));
     }
-    QRectF boundingRect() const override
+    AbstractDataSeriesAdaptor *clone() const override
     {
-        if (!size())
-            return QRectF();
-
-        if (yonly_)
-        {
-            qreal y1(vy[0]), y2(y1);
-            for (int i = 1; i < size(); ++i)
-            {
-                if (vy[i] < y1)
-                    y1 = vy[i];
-                else if (vy[i] > y2)
-                    y2 = vy[i];
-            }
-            return QRectF(0, y1, size() - 1, y2 - y1);
-        }
-
-        qreal x1(vx[0]), x2(x1);
-        qreal y1(vy[0]), y2(y1);
-        for (int i = 1; i < size(); ++i)
+        // other containers may change under the render thread
+        if constexpr (!ImplicitlyShared<V_>::value)
+            return nullptr;
+        else
         {
-            if (vx[i] < x1)
-                x1 = vx[i];
-            else if (vx[i] > x2)
-                x2 = vx[i];
-            if (vy[i] < y1)
-                y1 = vy[i];
-            else if (vy[i] > y2)
-                y2 = vy[i];
+            DataSeriesAdaptor *c = new DataSeriesAdaptor(*this);
+            c->detach();
+            return c;
         }
-        return QRectF(x1, y1, x2 - x1, y2 - y1);
+    }
+    bool view(SeriesView &v) const override
+    {
+        v.x = yonly_ ? nullptr : viewData(vx, v.xtype, 0);
+        v.y = viewData(vy, v.ytype, 0);
+        v.xstride = v.ystride = 1;
+        v.xscale = xScale;
+        v.yscale = yScale;
+        v.size = size();
+        return v.y && (yonly_ || v.x);
     }
 };
 
 template <class VectorType>
-class StairsAdaptor : public AbstractDataSeriesAdaptor
+class StairsAdaptor : public CachedSeriesAdaptor
 {
     VectorType x_, y_;
     bool yonly_;
 
+    void attach()
+    {
+        if (!yonly_)
+            attachChangeListener(x_, this, 0);
+        attachChangeListener(y_, this, 0);
+    }
+    void detach()
+    {
+        if (!yonly_)
+            detachChangeListener(x_, this, 0);
+        detachChangeListener(y_, this, 0);
+    }
+
+protected:
+    QPointF storedSample(int i) const override { return QPointF(yonly_ ? i : x_[i], y_[i]); }
+    bool hasX() const override { return !yonly_; }
+
 public:
     explicit StairsAdaptor(const VectorType &y)
         : y_(y), yonly_(true)
     {
+        attach();
     }
     StairsAdaptor(const VectorType &x, const VectorType &y)
         : x_(x), y_(y), yonly_(false)
     {
+        attach();
+    }
+    StairsAdaptor(const StairsAdaptor &other)
+        : CachedSeriesAdaptor(other)
+        , x_(other.x_)
+        , y_(other.y_)
+        , yonly_(other.yonly_)
+    {
+        attach();
     }
-    StairsAdaptor(const StairsAdaptor &other) = default;
-    int size() const override
+    ~StairsAdaptor() { detach(); }
+    // replace the data in place
+    void setData(const VectorType &x, const VectorType &y)
     {
-        return yonly_ ? 2 * y_.size() - 1 : 2 * std::min(x_.size(), y_.size()) - 1;
+        detach();
+        x_ = x;
+        y_ = y;
+        yonly_ = false;
+        attach();
+        invalidate();
     }
+    void setYData(const VectorType &y)
+    {
+        detach();
+        y_ = y;
+        attach();
+        invalidate();
+    }
+    // the N data points; the backend draws the steps between them
+    int size() const override { return yonly_ ? y_.size() : std::min(x_.size(), y_.size()); }
     QPointF sample(int i) const override
     {
-        int ix = (i + 1) >> 1;
-        int iy = i >> 1;
-        return yonly_ ? QPointF(ix, y_[iy]) : QPointF(x_[ix], y_[iy]);
+        return QPointF(xScale(yonly_ ? i : x_[i]), yScale(y_[i]));
     }
-    QRectF boundingRect() const override
+    AbstractDataSeriesAdaptor *clone() const override
     {
-        if (!size())
-            return QRectF();
-
-        if (yonly_)
+        if constexpr (!ImplicitlyShared<VectorType>::value)
+            return nullptr;
+        else
         {
-            qreal y1(y_[0]), y2(y1);
-            int N = size() >> 1;
-            for (int i = 1; i < N; ++i)
-            {
-                if (y_[i] < y1)
-                    y1 = y_[i];
-                else if (y_[i] > y2)
-                    y2 = y_[i];
-            }
-            return QRectF(0, y1, N - 1, y2 - y1);
+            StairsAdaptor *c = new StairsAdaptor(*this);
+            c->detach();
+            return c;
         }
+    }
+    bool view(SeriesView &v) const override
+    {
+        v.x = yonly_ ? nullptr : viewData(x_, v.xtype, 0);
+        v.y = viewData(y_, v.ytype, 0);
+        v.xstride = v.ystride = 1;
+        v.xscale = xScale;
+        v.yscale = yScale;
+        v.size = size();
+        return v.y && (yonly_ || v.x);
+    }
+    bool steps() const override { return true; }
+};
+
+template <class V_>
+class ScatterAdaptor : public DataSeriesAdaptor<V_>, public ScatterMarkers
+{
+    V_ sz_, c_;
+    double area_{36.};
+    bool sizes_{false}, values_{false};
+
+protected:
+    int valueCount() const override { return values_ ? int(c_.size()) : 0; }
+    double storedValue(int i) const override { return c_[i]; }
+    const void *valueData(SeriesView::Type &t) const override { return viewData(c_, t, 0); }
+
+public:
+    ScatterAdaptor(const V_ &x, const V_ &y)
+        : DataSeriesAdaptor<V_>(x, y)
+    {
+    }
+    void setSizes(double sz)
+    {
+        area_ = sz;
+        sz_ = V_();
+        sizes_ = false;
+    }
+    void setSizes(const V_ &sz)
+    {
+        sz_ = sz;
+        sizes_ = true;
+    }
+    void setColors(const V_ &c)
+    {
+        c_ = c;
+        values_ = true;
+        this->valuesChanged();
+    }
+    double area(int i) const override { return sizes_ && i < sz_.size() ? sz_[i] : area_; }
+    bool uniformArea() const override { return !sizes_; }
+    bool hasValues() const override { return values_; }
+    double value(int i) const override { return i < c_.size() ? c_[i] : 0.; }
+    void valueRange(double &vmin, double &vmax) const override
+    {
+        this->cachedValueRange(vmin, vmax);
+    }
+    AbstractDataSeriesAdaptor *clone() const override
+    {
+        if constexpr (!ImplicitlyShared<V_>::value)
+            return nullptr;
         else
         {
-            qreal x1(x_[0]), x2(x1);
-            qreal y1(y_[0]), y2(y1);
-            int N = size() >> 1;
-            for (int i = 1; i < N; ++i)
-            {
-                if (x_[i] < x1)
-                    x1 = x_[i];
-                else if (x_[i] > x2)
-                    x2 = x_[i];
-                if (y_[i] < y1)
-                    y1 = y_[i];
-                else if (y_[i] > y2)
-                    y2 = y_[i];
-            }
-            return QRectF(x1, y1, x2 - x1, y2 - y1);
+            ScatterAdaptor *c = new ScatterAdaptor(*this);
+            c->detach();
+            return c;
         }
     }
 };
 
 template <class VectorType>
-inline void QMatPlotWidget::plot(const VectorType &y, const QString &attr, const QColor &clr)
+inline PlotHandle QMatPlotWidget::plot(const VectorType &y, const QString &attr, const QColor &clr)
 {
-    __plot__(new DataSeriesAdaptor<VectorType>(y), attr, clr);
+    const int id = __plot__(new DataSeriesAdaptor<VectorType>(y), attr, clr);
+    return PlotHandle(this, id, PlotHandle::Line);
 }
 
 template <class VectorType>
-inline void QMatPlotWidget::plot(const VectorType &x,
-                                 const VectorType &y,
-                                 const QString &attr,
-                                 const QColor &clr)
+inline PlotHandle QMatPlotWidget::plot(const VectorType &x,
+                                       const VectorType &y,
+                                       const QString &attr,
+                                       const QColor &clr)
 {
-    __plot__(new DataSeriesAdaptor<VectorType>(x, y), attr, clr);
+    const int id = __plot__(new DataSeriesAdaptor<VectorType>(x, y), attr, clr);
+    return PlotHandle(this, id, PlotHandle::Line);
 }
 
 template <class VectorType>
-inline void QMatPlotWidget::stairs(const VectorType &y, const QString &attr, const QColor &clr)
+inline PlotHandle QMatPlotWidget::stairs(const VectorType &y,
+                                         const QString &attr,
+                                         const QColor &clr)
 {
-    __plot__(new StairsAdaptor<VectorType>(y), attr, clr);
+    const int id = __plot__(new StairsAdaptor<VectorType>(y), attr, clr);
+    return PlotHandle(this, id, PlotHandle::Stairs);
 }
 
 template <class VectorType>
-inline void QMatPlotWidget::stairs(const VectorType &x,
-                                   const VectorType &y,
-                                   const QString &attr,
-                                   const QColor &clr)
+inline PlotHandle QMatPlotWidget::stairs(const VectorType &x,
+                                         const VectorType &y,
+                                         const QString &attr,
+                                         const QColor &clr)
 {
-    __plot__(new StairsAdaptor<VectorType>(x, y), attr, clr);
+    const int id = __plot__(new StairsAdaptor<VectorType>(x, y), attr, clr);
+    return PlotHandle(this, id, PlotHandle::Stairs);
 }
 
-/*---- Templated errorbar functions -------*/
+template <class VectorType>
+inline PlotHandle QMatPlotWidget::scatter(const VectorType &x,
+                                          const VectorType &y,
+                                          double sz,
+                                          const QString &attr,
+                                          const QColor &clr)
+{
+    ScatterAdaptor<VectorType> *d = new ScatterAdaptor<VectorType>(x, y);
+    d->setSizes(sz);
+    return PlotHandle(this, __scatter__(d, attr, clr), PlotHandle::Scatter);
+}
 
-struct AbstractErrorBarAdaptor
+template <class VectorType>
+inline PlotHandle QMatPlotWidget::scatter(const VectorType &x,
+                                          const VectorType &y,
+                                          const VectorType &sz,
+                                          const QString &attr,
+                                          const QColor &clr)
 {
-    virtual ~AbstractErrorBarAdaptor() {}
-    virtual int size() const = 0;
-    virtual QPointF sample(int i) const = 0;
-    virtual QPointF interval(int i) const = 0;
-    virtual QRectF boundingRect() const = 0;
-    virtual QRectF errorBoundingRect() const = 0;
-};
+    ScatterAdaptor<VectorType> *d = new ScatterAdaptor<VectorType>(x, y);
+    d->setSizes(sz);
+    return PlotHandle(this, __scatter__(d, attr, clr), PlotHandle::Scatter);
+}
 
 template <class VectorType>
-class ErrorBarAdaptor : public AbstractErrorBarAdaptor
+inline PlotHandle QMatPlotWidget::scatter(const VectorType &x,
+                                          const VectorType &y,
+                                          double sz,
+                                          const VectorType &c,
+                                          const QString &attr)
 {
-    VectorType x_, y_, ym_, yp_;
+    ScatterAdaptor<VectorType> *d = new ScatterAdaptor<VectorType>(x, y);
+    d->setSizes(sz);
+    d->setColors(c);
+    return PlotHandle(this, __scatter__(d, attr, QColor()), PlotHandle::Scatter);
+}
+
+template <class VectorType>
+inline PlotHandle QMatPlotWidget::scatter(const VectorType &x,
+                                          const VectorType &y,
+                                          const VectorType &sz,
+                                          const VectorType &c,
+                                          const QString &attr)
+{
+    ScatterAdaptor<VectorType> *d = new ScatterAdaptor<VectorType>(x, y);
+    d->setSizes(sz);
+    d->setColors(c);
+    return PlotHandle(this, __scatter__(d, attr, QColor()), PlotHandle::Scatter);
+}
+
+/*---- Templated errorbar functions -------*/
+
+template <class VectorType>
+class ErrorBarAdaptor : public CachedErrorBarAdaptor
+{
+    // the errors are a single value, a vector or a vector for each side
+    enum Errors
+    {
+        Scalar,
+        Symmetric,
+        Asymmetric
+    };
+
+    VectorType x_, y_;
+    VectorType errm_, errp_; // per sample errors, see errors_
+    double err_{0.};
+    Errors errors_{Scalar};
     bool yonly_;
 
-public:
-    ErrorBarAdaptor(const VectorType &y, double err)
-        : y_(y), ym_(y.size()), yp_(y.size()), yonly_(true)
+    void attach()
+    {
+        if (!yonly_)
+            attachChangeListener(x_, this, 0);
+        attachChangeListener(y_, this, 0);
+        if (errors_ != Scalar)
+            attachChangeListener(errm_, this, 0);
+        if (errors_ == Asymmetric)
+            attachChangeListener(errp_, this, 0);
+    }
+    void detach()
+    {
+        if (!yonly_)
+            detachChangeListener(x_, this, 0);
+        detachChangeListener(y_, this, 0);
+        if (errors_ != Scalar)
+            detachChangeListener(errm_, this, 0);
+        if (errors_ == Asymmetric)
+            detachChangeListener(errp_, this, 0);
+    }
+    // the errors are kept as given and applied on demand by interval()
+    void setErrors(double err)
+    {
+        err_ = err;
+        errm_ = errp_ = VectorType();
+        errors_ = Scalar;
+    }
+    void setErrors(const VectorType &err)
+    {
+        errm_ = err;
+        errp_ = VectorType();
+        errors_ = Symmetric;
+    }
+    void setErrors(const VectorType &errm, const VectorType &errp)
     {
-        for (int i = 0; i < y.size(); ++i)
+        errm_ = errm;
+        errp_ = errp;
+        errors_ = Asymmetric;
+    }
+    double errorMinus(int i) const { return errors_ == Scalar ? err_ : errm_[i]; }
+    double errorPlus(int i) const
+    {
+        return errors_ == Scalar ? err_ : errors_ == Symmetric ? errm_[i] : errp_[i];
+    }
+
+protected:
+    QPointF storedSample(int i) const override { return QPointF(yonly_ ? i : x_[i], y_[i]); }
+    bool hasX() const override { return !yonly_; }
+    double commonError() const override
+    {
+        return errors_ == Scalar ? err_ : std::numeric_limits<double>::quiet_NaN();
+    }
+    void scanErrors(int from, int to, double &lo, double &hi) const override
+    {
+        // NaN values fail the compares and are skipped
+        for (int i = from; i < to; ++i)
         {
-            ym_[i] = y[i] - err;
-            yp_[i] = y[i] + err;
+            const double y = y_[i];
+            const double l = y - errorMinus(i), h = y + errorPlus(i);
+            lo = l < lo ? l : lo;
+            hi = h > hi ? h : hi;
         }
     }
+
+public:
+    ErrorBarAdaptor(const VectorType &y, double err)
+        : y_(y), yonly_(true)
+    {
+        setErrors(err);
+        attach();
+    }
     ErrorBarAdaptor(const VectorType &x, const VectorType &y, double err)
-        : x_(x), y_(y), ym_(y.size()), yp_(y.size()), yonly_(false)
+        : x_(x), y_(y), yonly_(false)
     {
-        for (int i = 0; i < y.size(); ++i)
-        {
-            ym_[i] = y[i] - err;
-            yp_[i] = y[i] + err;
-        }
+        setErrors(err);
+        attach();
     }
     ErrorBarAdaptor(const VectorType &y, const VectorType &err)
-        : y_(y), ym_(y.size()), yp_(y.size()), yonly_(true)
+        : y_(y), yonly_(true)
     {
-        for (int i = 0; i < y.size(); ++i)
-        {
-            ym_[i] = y[i] - err[i];
-            yp_[i] = y[i] + err[i];
-        }
+        setErrors(err);
+        attach();
     }
     ErrorBarAdaptor(const VectorType &x, const VectorType &y, const VectorType &err)
-        : x_(x), y_(y), ym_(y.size()), yp_(y.size()), yonly_(false)
+        : x_(x), y_(y), yonly_(false)
     {
-        for (int i = 0; i < y.size(); ++i)
-        {
-            ym_[i] = y[i] - err[i];
-            yp_[i] = y[i] + err[i];
-        }
+        setErrors(err);
+        attach();
     }
     ErrorBarAdaptor(const VectorType &x,
                     const VectorType &y,
                     const VectorType &errm,
                     const VectorType &errp)
-        : x_(x), y_(y), ym_(y.size()), yp_(y.size()), yonly_(false)
+        : x_(x), y_(y), yonly_(false)
     {
-        for (int i = 0; i < y.size(); ++i)
-        {
-            ym_[i] = y[i] - errm[i];
-            yp_[i] = y[i] + errp[i];
-        }
+        setErrors(errm, errp);
+        attach();
+    }
+    ErrorBarAdaptor(const ErrorBarAdaptor &other)
+        : CachedErrorBarAdaptor(other)
+        , x_(other.x_)
+        , y_(other.y_)
+        , errm_(other.errm_)
+        , errp_(other.errp_)
+        , err_(other.err_)
+        , errors_(other.errors_)
+        , yonly_(other.yonly_)
+    {
+        attach();
+    }
+    ~ErrorBarAdaptor() { detach(); }
+    // replace the data in place
+    template <class E_>
+    void setData(const VectorType &x, const VectorType &y, const E_ &err)
+    {
+        detach();
+        x_ = x;
+        y_ = y;
+        yonly_ = false;
+        setErrors(err);
+        attach();
+        invalidate();
+    }
+    template <class E_>
+    void setYData(const VectorType &y, const E_ &err)
+    {
+        detach();
+        y_ = y;
+        setErrors(err);
+        attach();
+        invalidate();
     }
-    ErrorBarAdaptor(const ErrorBarAdaptor &other) = default;
     int size() const override { return yonly_ ? y_.size() : std::min(x_.size(), y_.size()); }
     QPointF sample(int i) const override
     {
-        return yonly_ ? QPointF(i, y_[i]) : QPointF(x_[i], y_[i]);
+        return QPointF(xScale(yonly_ ? i : x_[i]), yScale(y_[i]));
     }
-    QPointF interval(int i) const override { return QPointF(ym_[i], yp_[i]); }
-    QRectF boundingRect() const override
+    bool view(SeriesView &v) const override
     {
-        if (!size())
-            return QRectF();
-
-        if (yonly_)
-        {
-            qreal y1(y_[0]), y2(y1);
-            for (int i = 1; i < size(); ++i)
-            {
-                if (y_[i] < y1)
-                    y1 = y_[i];
-                else if (y_[i] > y2)
-                    y2 = y_[i];
-            }
-            return QRectF(0, y1, size() - 1, y2 - y1);
-        }
-
-        qreal x1(x_[0]), x2(x1);
-        qreal y1(y_[0]), y2(y1);
-        for (int i = 1; i < size(); ++i)
-        {
-            if (x_[i] < x1)
-                x1 = x_[i];
-            else if (x_[i] > x2)
-                x2 = x_[i];
-            if (y_[i] < y1)
-                y1 = y_[i];
-            else if (y_[i] > y2)
-                y2 = y_[i];
-        }
-        return QRectF(x1, y1, x2 - x1, y2 - y1);
+        v.x = yonly_ ? nullptr : viewData(x_, v.xtype, 0);
+        v.y = viewData(y_, v.ytype, 0);
+        v.xstride = v.ystride = 1;
+        v.xscale = xScale;
+        v.yscale = yScale;
+        v.size = size();
+        return v.y && (yonly_ || v.x);
     }
-    QRectF errorBoundingRect() const override
+    QPointF interval(int i) const override
     {
-        if (!size())
-            return QRectF();
-
-        if (yonly_)
-        {
-            qreal y1(ym_[0]), y2(yp_[0]);
-            for (int i = 1; i < size(); ++i)
-            {
-                y1 = std::min(y1, ym_[i]);
-                y2 = std::max(y2, yp_[i]);
-            }
-            return QRectF(0, y1, size() - 1, y2 - y1);
-        }
-
-        qreal x1(x_[0]), x2(x1);
-        qreal y1(ym_[0]), y2(yp_[0]);
-        for (int i = 1; i < size(); ++i)
+        const double y = y_[i];
+        const double lo = yScale(y - errorMinus(i)), hi = yScale(y + errorPlus(i));
+        // a negative scale flips the bars
+        return lo <= hi ? QPointF(lo, hi) : QPointF(hi, lo);
+    }
+    AbstractErrorBarAdaptor *clone() const override
+    {
+        if constexpr (!ImplicitlyShared<VectorType>::value)
+            return nullptr;
+        else
         {
-            x1 = std::min(x1, x_[i]);
-            x2 = std::max(x2, x_[i]);
-            y1 = std::min(y1, ym_[i]);
-            y2 = std::max(y2, yp_[i]);
+            ErrorBarAdaptor *c = new ErrorBarAdaptor(*this);
+            c->detach();
+            return c;
         }
-        return QRectF(x1, y1, x2 - x1, y2 - y1);
     }
 };
 
 template <class VectorType>
-inline void QMatPlotWidget::errorbar(const VectorType &x,
-                                     const VectorType &y,
-                                     const VectorType &dym,
-                                     const VectorType &dyp,
-                                     const QString &attr,
-                                     const QColor &clr)
+inline PlotHandle QMatPlotWidget::errorbar(const VectorType &x,
+                                           const VectorType &y,
+                                           const VectorType &dym,
+                                           const VectorType &dyp,
+                                           const QString &attr,
+                                           const QColor &clr)
 {
-    __errorbar__(new ErrorBarAdaptor<VectorType>(x, y, dym, dyp), attr, clr);
+    const int id = __errorbar__(new ErrorBarAdaptor<VectorType>(x, y, dym, dyp), attr, clr);
+    return PlotHandle(this, id, PlotHandle::ErrorBar);
 }
 
 template <class VectorType>
-inline void QMatPlotWidget::errorbar(
-    const VectorType &x, const VectorType &y, double dy, const QString &attr, const QColor &clr)
+inline PlotHandle QMatPlotWidget::errorbar(const VectorType &x,
+                                           const VectorType &y,
+                                           double dy,
+                                           const QString &attr,
+                                           const QColor &clr)
 {
-    __errorbar__(new ErrorBarAdaptor<VectorType>(x, y, dy), attr, clr);
+    const int id = __errorbar__(new ErrorBarAdaptor<VectorType>(x, y, dy), attr, clr);
+    return PlotHandle(this, id, PlotHandle::ErrorBar);
 }
 
 template <class VectorType>
-inline void QMatPlotWidget::errorbar(const VectorType &y,
-                                     double dy,
-                                     const QString &attr,
-                                     const QColor &clr)
+inline PlotHandle QMatPlotWidget::errorbar(const VectorType &y,
+                                           double dy,
+                                           const QString &attr,
+                                           const QColor &clr)
 {
-    __errorbar__(new ErrorBarAdaptor<VectorType>(y, dy), attr, clr);
+    const int id = __errorbar__(new ErrorBarAdaptor<VectorType>(y, dy), attr, clr);
+    return PlotHandle(this, id, PlotHandle::ErrorBar);
 }
 
 template <class VectorType>
-inline void QMatPlotWidget::errorbar(const VectorType &x,
-                                     const VectorType &y,
-                                     const VectorType &dy,
-                                     const QString &attr,
-                                     const QColor &clr)
+inline PlotHandle QMatPlotWidget::errorbar(const VectorType &x,
+                                           const VectorType &y,
+                                           const VectorType &dy,
+                                           const QString &attr,
+                                           const QColor &clr)
 {
-    __errorbar__(new ErrorBarAdaptor<VectorType>(x, y, dy), attr, clr);
+    const int id = __errorbar__(new ErrorBarAdaptor<VectorType>(x, y, dy), attr, clr);
+    return PlotHandle(this, id, PlotHandle::ErrorBar);
 }
 
 template <class VectorType>
-inline void QMatPlotWidget::errorbar(const VectorType &y,
-                                     const VectorType &dy,
-                                     const QString &attr,
-                                     const QColor &clr)
+inline PlotHandle QMatPlotWidget::errorbar(const VectorType &y,
+                                           const VectorType &dy,
+                                           const QString &attr,
+                                           const QColor &clr)
 {
-    __errorbar__(new ErrorBarAdaptor<VectorType>(y, dy), attr, clr);
+    const int id = __errorbar__(new ErrorBarAdaptor<VectorType>(y, dy), attr, clr);
+    return PlotHandle(this, id, PlotHandle::ErrorBar);
 }
 
 /*---- Templated image functions -------*/
 
-struct AbstractImageAdaptor
-{
-    virtual ~AbstractImageAdaptor() {}
-    virtual int rows() const = 0;
-    virtual int columns() const = 0;
-    virtual double value(int k) const = 0;
-    virtual QPointF xlim() const = 0;
-    virtual QPointF ylim() const = 0;
-    virtual QPointF zlim() const = 0;
-};
-
 template <class VectorType>
 class ImageAdaptor : public AbstractImageAdaptor
 {
@@ -580,9 +1172,19 @@ public:
     {
     }
     ImageAdaptor(const ImageAdaptor &other) = default;
+    // replace the data in place, keeping the number of columns
+    void setData(const VectorType &z) { z_ = z; }
+    AbstractImageAdaptor *clone() const override
+    {
+        if constexpr (!ImplicitlyShared<VectorType>::value)
+            return nullptr;
+        else
+            return new ImageAdaptor(*this);
+    }
     int rows() const override { return z_.size() / cols_; }
     int columns() const override { return cols_; }
     double value(int k) const override { return z_[k]; }
+    const double *valueData() const override { return contiguousData(z_, 0); }
     QPointF xlim() const override
     {
         if (zonly_)
@@ -605,48 +1207,267 @@ public:
             return QPointF(y_[0], y_[y_.size() - 1]);
         }
     }
-    QPointF zlim() const override
-    {
-        if (!z_.size())
-            return QPointF(0., 1.);
-        double vmin = z_[0], vmax = z_[0];
-        for (int i = 1; i < z_.size(); ++i)
-        {
-            vmin = std::min(vmin, z_[i]);
-            vmax = std::max(vmax, z_[i]);
-        }
-        return QPointF(vmin, vmax);
-    }
 };
 
 template <class VectorType>
-inline void QMatPlotWidget::imagesc(const VectorType &z, int columns)
+inline PlotHandle QMatPlotWidget::hist2d(const VectorType &x,
+                                         const VectorType &y,
+                                         int nbinsx,
+                                         int nbinsy)
+{
+    const int id = __hist2d__(new DataSeriesAdaptor<VectorType>(x, y), nbinsx, nbinsy);
+    return PlotHandle(this, id, PlotHandle::Image);
+}
+
+template <class VectorType>
+inline PlotHandle QMatPlotWidget::imagesc(const VectorType &z, int columns)
 {
-    __image__(new ImageAdaptor<VectorType>(z, columns), true);
+    const int id = __image__(new ImageAdaptor<VectorType>(z, columns), true);
+    return PlotHandle(this, id, PlotHandle::Image);
 }
 
 template <class VectorType>
-inline void QMatPlotWidget::imagesc(const VectorType &x,
-                                    const VectorType &y,
-                                    const VectorType &z,
-                                    int columns)
+inline PlotHandle QMatPlotWidget::imagesc(const VectorType &x,
+                                          const VectorType &y,
+                                          const VectorType &z,
+                                          int columns)
 {
-    __image__(new ImageAdaptor<VectorType>(x, y, z, columns), true);
+    const int id = __image__(new ImageAdaptor<VectorType>(x, y, z, columns), true);
+    return PlotHandle(this, id, PlotHandle::Image);
 }
 
 template <class VectorType>
-inline void QMatPlotWidget::image(const VectorType &z, int columns)
+inline PlotHandle QMatPlotWidget::image(const VectorType &z, int columns)
 {
-    __image__(new ImageAdaptor<VectorType>(z, columns), false);
+    const int id = __image__(new ImageAdaptor<VectorType>(z, columns), false);
+    return PlotHandle(this, id, PlotHandle::Image);
 }
 
 template <class VectorType>
-inline void QMatPlotWidget::image(const VectorType &x,
-                                  const VectorType &y,
-                                  const VectorType &z,
-                                  int columns)
+inline PlotHandle QMatPlotWidget::image(const VectorType &x,
+                                        const VectorType &y,
+                                        const VectorType &z,
+                                        int columns)
 {
-    __image__(new ImageAdaptor<VectorType>(x, y, z, columns), false);
+    const int id = __image__(new ImageAdaptor<VectorType>(x, y, z, columns), false);
+    return PlotHandle(this, id, PlotHandle::Image);
 }
 
+/*---- Plot handles -------*/
+
+template <class V_>
+inline bool PlotHandle::setData(const V_ &x, const V_ &y)
+{
+    AbstractDataSeriesAdaptor *d = seriesAdaptor();
+    if (!d)
+        return false;
+    if (kind_ == Stairs)
+    {
+        if (StairsAdaptor<V_> *a = dynamic_cast<StairsAdaptor<V_> *>(d))
+        {
+            a->setData(x, y);
+            return dataChanged();
+        }
+        return replace(new StairsAdaptor<V_>(x, y));
+    }
+    if (DataSeriesAdaptor<V_> *a = dynamic_cast<DataSeriesAdaptor<V_> *>(d))
+    {
+        a->setData(x, y);
+        return dataChanged();
+    }
+    // the sizes and colors of a scatter plot are of its vector type
+    if (kind_ == Scatter)
+        return false;
+    return replace(new DataSeriesAdaptor<V_>(x, y));
+}
+
+template <class V_>
+inline bool PlotHandle::setYData(const V_ &y)
+{
+    AbstractDataSeriesAdaptor *d = seriesAdaptor();
+    if (StairsAdaptor<V_> *a = dynamic_cast<StairsAdaptor<V_> *>(d))
+        a->setYData(y);
+    else if (DataSeriesAdaptor<V_> *a = dynamic_cast<DataSeriesAdaptor<V_> *>(d))
+        a->setYData(y);
+    else
+        return false;
+    return dataChanged();
+}
+
+template <class V_, class E_>
+inline bool PlotHandle::setData(const V_ &x, const V_ &y, const E_ &dy)
+{
+    AbstractErrorBarAdaptor *d = errorBarAdaptor();
+    if (!d)
+        return false;
+    if (ErrorBarAdaptor<V_> *a = dynamic_cast<ErrorBarAdaptor<V_> *>(d))
+    {
+        a->setData(x, y, dy);
+        return dataChanged();
+    }
+    return replace(new ErrorBarAdaptor<V_>(x, y, dy));
+}
+
+template <class V_, class E_>
+inline bool PlotHandle::setYData(const V_ &y, const E_ &dy)
+{
+    ErrorBarAdaptor<V_> *a = dynamic_cast<ErrorBarAdaptor<V_> *>(errorBarAdaptor());
+    if (!a)
+        return false;
+    a->setYData(y, dy);
+    return dataChanged();
+}
+
+template <class V_, class>
+inline bool PlotHandle::appendRow(const V_ &z)
+{
+    const int n = int(z.size());
+    if (const double *p = contiguousData(z, 0))
+        return appendRow(p, n);
+    QVector<double> row(n);
+    for (int i = 0; i < n; ++i)
+        row[i] = z[i];
+    return appendRow(row.constData(), n);
+}
+
+template <class V_>
+inline bool PlotHandle::setZData(const V_ &z)
+{
+    ImageAdaptor<V_> *a = dynamic_cast<ImageAdaptor<V_> *>(imageAdaptor());
+    if (!a)
+        return false;
+    a->setData(z);
+    return dataChanged();
+}
+
+/*---- Non-owning plot functions -------*/
+
+template <class T>
+inline PlotHandle QMatPlotWidget::plot(const T *x,
+                                       const T *y,
+                                       int n,
+                                       const QString &attr,
+                                       const QColor &clr)
+{
+    return plot(DataView<T>(x, n), DataView<T>(y, n), attr, clr);
+}
+
+template <class T>
+inline PlotHandle QMatPlotWidget::plot(const T *y,
+                                       int n,
+                                       const QString &attr,
+                                       const QColor &clr)
+{
+    return plot(DataView<T>(y, n), attr, clr);
+}
+
+template <class T>
+inline PlotHandle QMatPlotWidget::stairs(const T *x,
+                                         const T *y,
+                                         int n,
+                                         const QString &attr,
+                                         const QColor &clr)
+{
+    return stairs(DataView<T>(x, n), DataView<T>(y, n), attr, clr);
+}
+
+template <class T>
+inline PlotHandle QMatPlotWidget::stairs(const T *y,
+                                         int n,
+                                         const QString &attr,
+                                         const QColor &clr)
+{
+    return stairs(DataView<T>(y, n), attr, clr);
+}
+
+inline PlotHandle QMatPlotWidget::errorbar(const double *x,
+                                           const double *y,
+                                           const double *dy,
+                                           int n,
+                                           const QString &attr,
+                                           const QColor &clr)
+{
+    return errorbar(DataView<double>(x, n),
+                    DataView<double>(y, n),
+                    DataView<double>(dy, n),
+                    attr,
+                    clr);
+}
+
+inline PlotHandle QMatPlotWidget::errorbar(const double *x,
+                                           const double *y,
+                                           double dy,
+                                           int n,
+                                           const QString &attr,
+                                           const QColor &clr)
+{
+    return errorbar(DataView<double>(x, n), DataView<double>(y, n), dy, attr, clr);
+}
+
+template <class T>
+inline PlotHandle QMatPlotWidget::hist2d(const T *x, const T *y, int n, int nbinsx, int nbinsy)
+{
+    return hist2d(DataView<T>(x, n), DataView<T>(y, n), nbinsx, nbinsy);
+}
+
+#ifdef __cpp_lib_span
+inline PlotHandle QMatPlotWidget::plot(std::span<const double> x,
+                                       std::span<const double> y,
+                                       const QString &attr,
+                                       const QColor &clr)
+{
+    return plot(DataView<double>(x), DataView<double>(y), attr, clr);
+}
+
+inline PlotHandle QMatPlotWidget::plot(std::span<const double> y,
+                                       const QString &attr,
+                                       const QColor &clr)
+{
+    return plot(DataView<double>(y), attr, clr);
+}
+
+inline PlotHandle QMatPlotWidget::stairs(std::span<const double> x,
+                                         std::span<const double> y,
+                                         const QString &attr,
+                                         const QColor &clr)
+{
+    return stairs(DataView<double>(x), DataView<double>(y), attr, clr);
+}
+
+inline PlotHandle QMatPlotWidget::stairs(std::span<const double> y,
+                                         const QString &attr,
+                                         const QColor &clr)
+{
+    return stairs(DataView<double>(y), attr, clr);
+}
+
+inline PlotHandle QMatPlotWidget::errorbar(std::span<const double> x,
+                                           std::span<const double> y,
+                                           std::span<const double> dy,
+                                           const QString &attr,
+                                           const QColor &clr)
+{
+    return errorbar(DataView<double>(x), DataView<double>(y), DataView<double>(dy), attr, clr);
+}
+
+inline PlotHandle QMatPlotWidget::errorbar(std::span<const double> x,
+                                           std::span<const double> y,
+                                           double dy,
+                                           const QString &attr,
+                                           const QColor &clr)
+{
+    return errorbar(DataView<double>(x), DataView<double>(y), dy, attr, clr);
+}
+
+inline PlotHandle QMatPlotWidget::hist2d(std::span<const double> x,
+                                         std::span<const double> y,
+                                         int nbinsx,
+                                         int nbinsy)
+{
+    return hist2d(DataView<double>(x), DataView<double>(y), nbinsx, nbinsy);
+}
+#endif
+
+Q_DECLARE_METATYPE(QMatPlotWidget::RenderStats)
+
 #endif //_QMATPLOTWIDGET_H_
@@ -0,0 +1,364 @@
+#ifndef _QMATPLOTWIDGET_ADAPTORS_H_
+#define _QMATPLOTWIDGET_ADAPTORS_H_
+
+// Adaptors between the plot functions and the containers of the data,
+// included by qmatplotwidget.h.
+//
+// The plot functions accept any container with size() and operator[]
+// and wrap it in one of the adaptors of qmatplotwidget.h. The hooks
+// declared here are the supported extension API of those adaptors and
+// of the user's own containers:
+//  - DataChangeNotifier, to report data modified in place
+//  - view(), to publish the memory of a series, see SeriesView
+//  - clone(), to render a copy in the render thread, see ImplicitlyShared
+//  - steps() and sortedX(), how the backend draws and clips a series
+// All of them are optional.
+
+#include "qmatplotwidget_export.h"
+
+#include <QList>
+#include <QPointF>
+#include <QRectF>
+#include <QVector>
+
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+class SeriesCache;
+class ErrorBarCache;
+
+/*---- Data change notification -------*/
+
+// Receives modification notices for the data of a series
+struct DataChangeListener
+{
+    virtual ~DataChangeListener() {}
+    // samples [from, to) were modified in place
+    virtual void dataChanged(int from, int to) = 0;
+    // all samples must be considered modified
+    virtual void invalidate() = 0;
+};
+
+// Notifier to be embedded in the (shared) data of a user container.
+//
+// Adaptors attach themselves to it if the container provides
+//     DataChangeNotifier *changeNotifier() const;
+// The container then reports in-place modifications with notifyChanged()
+// or notifyInvalidated(). Appended samples need no notification, they
+// are detected from the change in size().
+class DataChangeNotifier
+{
+    QVector<DataChangeListener *> listeners_;
+
+public:
+    DataChangeNotifier() {}
+    // a copy is a new container, listeners are not copied
+    DataChangeNotifier(const DataChangeNotifier &) {}
+    DataChangeNotifier &operator=(const DataChangeNotifier &) { return *this; }
+
+    void attach(DataChangeListener *l) { listeners_ << l; }
+    void detach(DataChangeListener *l) { listeners_.removeAll(l); }
+    void notifyChanged(int from, int to) const
+    {
+        for (DataChangeListener *l : listeners_)
+            l->dataChanged(from, to);
+    }
+    void notifyInvalidated() const
+    {
+        for (DataChangeListener *l : listeners_)
+            l->invalidate();
+    }
+};
+
+template <class V_>
+inline auto attachChangeListener(const V_ &v, DataChangeListener *l, int)
+    -> decltype(v.changeNotifier(), void())
+{
+    v.changeNotifier()->attach(l);
+}
+template <class V_>
+inline void attachChangeListener(const V_ &, DataChangeListener *, long)
+{
+}
+template <class V_>
+inline auto detachChangeListener(const V_ &v, DataChangeListener *l, int)
+    -> decltype(v.changeNotifier(), void())
+{
+    v.changeNotifier()->detach(l);
+}
+template <class V_>
+inline void detachChangeListener(const V_ &, DataChangeListener *, long)
+{
+}
+
+/*---- Stored sample values -------*/
+
+// Affine map v * scale + offset from stored to plotted values, for
+// series stored in compact types, e.g. ADC counts plotted in volts
+struct SampleScale
+{
+    double scale{1.};
+    double offset{0.};
+
+    double operator()(double v) const { return v * scale + offset; }
+};
+
+/*---- Raw access to contiguous data -------*/
+
+// Strided view of the memory of a series, published by adaptors of
+// contiguous containers so that the backend can read the samples
+// directly instead of calling sample() for each of them.
+// The samples are read in their stored type and mapped by the scales.
+struct SeriesView
+{
+    enum Type { Double, Float, Int32, Int16 };
+
+    const void *x{nullptr}; // nullptr if x is the sample index
+    const void *y{nullptr};
+    Type xtype{Double}; // if not ytype, sample() is used instead
+    Type ytype{Double};
+    std::ptrdiff_t xstride{1}; // in elements
+    std::ptrdiff_t ystride{1};
+    SampleScale xscale; // also of the sample index
+    SampleScale yscale;
+    int size{0};
+};
+
+// SeriesView::Type of T, if any
+template <class T>
+struct SeriesViewType
+{
+};
+template <>
+struct SeriesViewType<double>
+{
+    static constexpr SeriesView::Type value = SeriesView::Double;
+};
+template <>
+struct SeriesViewType<float>
+{
+    static constexpr SeriesView::Type value = SeriesView::Float;
+};
+template <>
+struct SeriesViewType<qint32>
+{
+    static constexpr SeriesView::Type value = SeriesView::Int32;
+};
+template <>
+struct SeriesViewType<qint16>
+{
+    static constexpr SeriesView::Type value = SeriesView::Int16;
+};
+
+// True for containers whose copies share the elements until one of them
+// is modified (copy-on-write). Only the adaptors of such containers are
+// copied for the render thread, see QMatPlotWidget::setThreadedRendering();
+// it may be specialized for other containers with the same semantics.
+template <class V_>
+struct ImplicitlyShared : std::false_type
+{
+};
+template <class T>
+struct ImplicitlyShared<QVector<T>> : std::true_type
+{
+};
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+template <class T>
+struct ImplicitlyShared<QList<T>> : std::true_type
+{
+};
+#endif
+
+// Pointer to the storage of containers holding contiguous elements of
+// a SeriesView type, which is stored in type; nullptr for all other
+// containers
+template <class V_, class P = decltype(std::declval<const V_ &>().data())>
+inline auto viewData(const V_ &v, SeriesView::Type &type, int)
+    -> decltype(SeriesViewType<std::remove_cv_t<std::remove_pointer_t<P>>>::value,
+                (const void *)nullptr)
+{
+    type = SeriesViewType<std::remove_cv_t<std::remove_pointer_t<P>>>::value;
+    return v.data();
+}
+template <class V_>
+inline const void *viewData(const V_ &, SeriesView::Type &, long)
+{
+    return nullptr;
+}
+
+// Pointer to the storage of containers holding contiguous doubles,
+// nullptr for all other containers
+template <class V_>
+inline auto contiguousData(const V_ &v, int) -> typename std::
+    enable_if<std::is_same<decltype(v.data()), const double *>::value, const double *>::type
+{
+    return v.data();
+}
+template <class V_>
+inline const double *contiguousData(const V_ &, long)
+{
+    return nullptr;
+}
+
+/*---- Series adaptors -------*/
+
+struct AbstractDataSeriesAdaptor : public DataChangeListener
+{
+    virtual ~AbstractDataSeriesAdaptor() {}
+    virtual int size() const = 0;
+    virtual QPointF sample(int i) const = 0;
+    virtual QRectF boundingRect() const = 0;
+    // fill v and return true if the samples can be read from memory
+    virtual bool view(SeriesView &) const { return false; }
+    // copy for rendering in another thread, not attached to change
+    // notifiers, which must not read memory the caller may modify (see
+    // ImplicitlyShared); nullptr if not supported, the item is then
+    // drawn by the GUI thread
+    virtual AbstractDataSeriesAdaptor *clone() const { return nullptr; }
+    // true if the series is drawn as a staircase, each sample holding
+    // its value up to the x of the next one
+    virtual bool steps() const { return false; }
+    // true if the x values are non-decreasing, so that the backend can
+    // find the visible samples by binary search
+    virtual bool sortedX() const { return xSorted; }
+
+    // x declared sorted with PlotHandle::setSortedX(), not checked
+    bool xSorted{false};
+    // map from the stored to the plotted values, set with
+    // PlotHandle::setXScale() and setYScale(); applied by sample(),
+    // boundingRect() and view() of the adaptors of containers
+    SampleScale xScale;
+    SampleScale yScale;
+};
+
+// Base of the adaptors of containers. The extents of the samples and
+// their runs without NaN are cached by the library, which reads them
+// from view() if possible and rescans only what dataChanged() reports.
+// A copy copies the caches as they are, so that render thread copies do
+// not scan again what was already scanned.
+class QMATPLOTWIDGET_EXPORT CachedSeriesAdaptor : public AbstractDataSeriesAdaptor
+{
+    friend class SeriesCache;
+    std::unique_ptr<SeriesCache> cache_;
+
+public:
+    CachedSeriesAdaptor();
+    CachedSeriesAdaptor(const CachedSeriesAdaptor &other);
+    CachedSeriesAdaptor &operator=(const CachedSeriesAdaptor &) = delete;
+    ~CachedSeriesAdaptor() override;
+
+    QRectF boundingRect() const override;
+    bool sortedX() const override;
+    void dataChanged(int from, int to) override;
+    void invalidate() override;
+    SeriesCache *cache() const { return cache_.get(); }
+
+protected:
+    // sample i as stored, before xScale and yScale
+    virtual QPointF storedSample(int i) const = 0;
+    // false if x is the sample index
+    virtual bool hasX() const = 0;
+    // color values of the points (see ScatterMarkers), none by default;
+    // read from valueData() if not null, else by storedValue()
+    virtual int valueCount() const { return 0; }
+    virtual double storedValue(int) const { return 0.; }
+    virtual const void *valueData(SeriesView::Type &) const { return nullptr; }
+    // range of the values, NaN ignored, cached and rescanned as the
+    // extents; empty (vmin > vmax) without values
+    void cachedValueRange(double &vmin, double &vmax) const;
+    // the values were replaced
+    void valuesChanged();
+};
+
+// Marker sizes and colors of the points of scatter plots
+struct ScatterMarkers
+{
+    virtual ~ScatterMarkers() {}
+    // marker area of point i, in pixels^2
+    virtual double area(int i) const = 0;
+    virtual bool uniformArea() const = 0;
+    // color value of point i, mapped to the color map over valueRange()
+    virtual bool hasValues() const = 0;
+    virtual double value(int i) const = 0;
+    virtual void valueRange(double &vmin, double &vmax) const = 0;
+};
+
+/*---- Error bar adaptors -------*/
+
+struct AbstractErrorBarAdaptor : public DataChangeListener
+{
+    virtual ~AbstractErrorBarAdaptor() {}
+    virtual int size() const = 0;
+    virtual QPointF sample(int i) const = 0;
+    virtual bool view(SeriesView &) const { return false; }
+    virtual QPointF interval(int i) const = 0;
+    virtual QRectF boundingRect() const = 0;
+    virtual QRectF errorBoundingRect() const = 0;
+    // see AbstractDataSeriesAdaptor::clone() and sortedX()
+    virtual AbstractErrorBarAdaptor *clone() const { return nullptr; }
+    virtual bool sortedX() const { return false; }
+
+    // see AbstractDataSeriesAdaptor; the y scale also maps the error
+    // bars, applied by interval()
+    SampleScale xScale;
+    SampleScale yScale;
+};
+
+// Base of the error bar adaptors of containers, see CachedSeriesAdaptor.
+// The extents of the error bars are found from commonError(), or by
+// scanErrors() if there is none.
+class QMATPLOTWIDGET_EXPORT CachedErrorBarAdaptor : public AbstractErrorBarAdaptor
+{
+    friend class ErrorBarCache;
+    std::unique_ptr<ErrorBarCache> cache_;
+
+public:
+    CachedErrorBarAdaptor();
+    CachedErrorBarAdaptor(const CachedErrorBarAdaptor &other);
+    CachedErrorBarAdaptor &operator=(const CachedErrorBarAdaptor &) = delete;
+    ~CachedErrorBarAdaptor() override;
+
+    QRectF boundingRect() const override;
+    QRectF errorBoundingRect() const override;
+    bool sortedX() const override;
+    void dataChanged(int from, int to) override;
+    void invalidate() override;
+    ErrorBarCache *cache() const { return cache_.get(); }
+
+protected:
+    // sample i as stored, before xScale and yScale
+    virtual QPointF storedSample(int i) const = 0;
+    // false if x is the sample index
+    virtual bool hasX() const = 0;
+    // the error of all samples, NaN if each one has its own
+    virtual double commonError() const = 0;
+    // fold the ends of the error bars of the samples [from, to) into
+    // [lo, hi]; may be called from several threads at once
+    virtual void scanErrors(int from, int to, double &lo, double &hi) const = 0;
+};
+
+/*---- Image adaptors -------*/
+
+struct QMATPLOTWIDGET_EXPORT AbstractImageAdaptor
+{
+    virtual ~AbstractImageAdaptor() {}
+    virtual int rows() const = 0;
+    virtual int columns() const = 0;
+    virtual double value(int k) const = 0;
+    // the values in memory, row after row, or nullptr
+    virtual const double *valueData() const { return nullptr; }
+    virtual QPointF xlim() const = 0;
+    virtual QPointF ylim() const = 0;
+    // range of the values, by default found by the library from
+    // valueData() or value(); (0, 1) if there are none
+    virtual QPointF zlim() const;
+    // see AbstractDataSeriesAdaptor::clone()
+    virtual AbstractImageAdaptor *clone() const { return nullptr; }
+    // the data were modified in place
+    virtual void invalidate() {}
+};
+
+#endif
+// #ifndef _QMATPLOTWIDGET_ADAPTORS_H_
@@ -2,15 +2,61 @@
 #define _QMATPLOTWIDGET_P_H_
 
 #include "qmatplotwidget.h"
+#include "adaptors_p.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
 
 struct QMatPlotWidget::Backend
 {
     virtual bool exportToFile(const QString &fname, const QSize &sz) = 0;
     virtual void clear() = 0;
     virtual void replot() = 0;
-    virtual void plot(AbstractDataSeriesAdaptor *d, const QMatPlotWidget::LineSpec &l) = 0;
-    virtual void errorbar(AbstractErrorBarAdaptor *d, const QMatPlotWidget::LineSpec &l) = 0;
-    virtual void image(AbstractImageAdaptor *d, bool scale, const QVector<QRgb> &cmap) = 0;
+    virtual void replotNow() = 0;
+    virtual void dataChanged() = 0;
+    virtual double maxFps() const = 0;
+    virtual void setMaxFps(double fps) = 0;
+    virtual quint64 mergedReplots() const = 0;
+    virtual quint64 frameCount() const = 0;
+    virtual quint64 imageCacheHitCount() const = 0;
+    virtual quint64 imageCacheMissCount() const = 0;
+    virtual bool threadedRendering() const = 0;
+    virtual void setThreadedRendering(bool on) = 0;
+    virtual quint64 droppedFrames() const = 0;
+    virtual QMatPlotWidget::RenderStats renderStats() const = 0;
+    virtual int statsInterval() const = 0;
+    virtual void setStatsInterval(int ms) = 0;
+    virtual void beginUpdate() = 0;
+    virtual void endUpdate() = 0;
+    virtual bool isUpdating() const = 0;
+    // add an item, return its id
+    virtual int plot(AbstractDataSeriesAdaptor *d, const QMatPlotWidget::LineSpec &l) = 0;
+    virtual int errorbar(AbstractErrorBarAdaptor *d, const QMatPlotWidget::LineSpec &l) = 0;
+    virtual int scatter(AbstractDataSeriesAdaptor *d,
+                        const QMatPlotWidget::LineSpec &l,
+                        const QVector<QRgb> &cmap) = 0;
+    virtual int image(AbstractImageAdaptor *d, bool scale, const QVector<QRgb> &cmap) = 0;
+    virtual int waterfall(int columns,
+                          int depth,
+                          const QPointF &xlim,
+                          const QPointF &clim,
+                          const QVector<QRgb> &cmap) = 0;
+    // false if n is not the number of columns of the waterfall
+    virtual bool appendRow(int id, const double *z, int n) = 0;
+    virtual void setClim(int id, const QPointF &clim) = 0;
+    // items by id (see PlotHandle)
+    virtual bool hasItem(int id) const = 0;
+    virtual AbstractDataSeriesAdaptor *seriesAdaptor(int id) const = 0;
+    virtual AbstractErrorBarAdaptor *errorBarAdaptor(int id) const = 0;
+    virtual AbstractImageAdaptor *imageAdaptor(int id) const = 0;
+    virtual void setSeriesAdaptor(int id, AbstractDataSeriesAdaptor *d) = 0;
+    virtual void setErrorBarAdaptor(int id, AbstractErrorBarAdaptor *d) = 0;
+    virtual void itemDataChanged(int id) = 0;
+    virtual void setItemStyle(int id, const QMatPlotWidget::LineSpec &l) = 0;
+    virtual void setItemColor(int id, const QColor &clr) = 0;
+    virtual void setItemVisible(int id, bool on) = 0;
+    virtual void removeItem(int id) = 0;
     virtual QPointF xlim() const = 0;
     virtual QPointF ylim() const = 0;
     virtual QString title() const = 0;
@@ -30,6 +76,178 @@ struct QMatPlotWidget::Backend
     virtual void setXlim(const QPointF &v) = 0;
     virtual void setYlim(const QPointF &v) = 0;
     virtual void setAxisEqual() = 0;
+    virtual void setColorScale(QMatPlotWidget::AxisScale sc) = 0;
+};
+
+/*---- Streaming series (streamingseries.cpp) -------*/
+
+// Signals the GUI thread that samples were queued to a streaming series
+class StreamNotifier : public QObject
+{
+    Q_OBJECT
+
+signals:
+    void updated();
+};
+
+// Lock-free single-producer/single-consumer queue feeding the
+// fixed-capacity history of a streaming series.
+//
+// The producer (any thread) writes to the queue and publishes the new
+// head; the consumer (GUI thread) moves queued samples into the history
+// in drain(). Only the consumer touches the history, so it needs no lock.
+class StreamingSeries
+{
+public:
+    explicit StreamingSeries(int capacity);
+    ~StreamingSeries();
+
+    // producer side
+    int append(const double *x, const double *y, int n);
+    quint64 dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+    // consumer side
+    int drain();
+    int size() const { return n_; }
+    QPointF sample(int i) const
+    {
+        int k = first_ + i;
+        if (k >= capacity_)
+            k -= capacity_;
+        return QPointF(hx_[k], hy_[k]);
+    }
+    bool view(SeriesView &v) const;
+    // the history in index order as two contiguous parts of doubles, the
+    // second one empty until the ring wraps around
+    void views(SeriesView &a, SeriesView &b) const;
+    // copy the history in index order to x and y, size() values each
+    void copy(double *x, double *y) const;
+    // a single run if no sample has NaN, see SegmentIndex
+    bool segments(QVector<SeriesSegment> &runs) const;
+    QRectF boundingRect();
+    void invalidate() { extents_.invalidate(); }
+    bool sortedX() const { return descents_ == 0; }
+
+    StreamNotifier *notifier() const { return notifier_; }
+    // samples drained so far, which changes with the history
+    quint64 version() const { return tail_.load(std::memory_order_relaxed); }
+
+    // cleared when the plot item goes away
+    std::atomic<bool> attached{true};
+
+private:
+    void push(double x, double y);
+
+    // queue, size is a power of 2
+    std::vector<double> qx_, qy_;
+    quint64 mask_;
+    std::atomic<quint64> head_{0};
+    std::atomic<quint64> tail_{0};
+    std::atomic<quint64> dropped_{0};
+    std::atomic<bool> pending_{false};
+    StreamNotifier *notifier_;
+
+    // history, a ring of capacity_ samples starting at first_
+    std::vector<double> hx_, hy_;
+    int capacity_;
+    int first_{0};
+    int n_{0};
+    // extents over the physical history indexes
+    ExtentsCache extents_;
+    // consecutive samples (in index order) with x out of order or NaN
+    int descents_{0};
+    // samples with NaN x or y
+    int nans_{0};
+};
+
+// Adaptor plotting the history of a StreamingSeries
+class StreamAdaptor : public AbstractDataSeriesAdaptor
+{
+public:
+    std::shared_ptr<StreamingSeries> s;
+
+    explicit StreamAdaptor(const std::shared_ptr<StreamingSeries> &p)
+        : s(p)
+    {
+    }
+    ~StreamAdaptor() { s->attached = false; }
+    int size() const override { return s->size(); }
+    QPointF sample(int i) const override { return s->sample(i); }
+    QRectF boundingRect() const override { return s->boundingRect(); }
+    bool view(SeriesView &v) const override { return s->view(v); }
+    void views(SeriesView &a, SeriesView &b) const { s->views(a, b); }
+    bool segments(QVector<SeriesSegment> &runs) const { return s->segments(runs); }
+    bool sortedX() const override { return xSorted || s->sortedX(); }
+    void dataChanged(int, int) override { s->invalidate(); }
+    void invalidate() override { s->invalidate(); }
+    AbstractDataSeriesAdaptor *clone() const override
+    {
+        // the history is only touched by the GUI thread: copy it in order,
+        // once per version, and share the copy with all the frames
+        // rendered until the next drain
+        if (!snapshot_ || snapshotVersion_ != s->version())
+        {
+            QVector<double> x(s->size()), y(s->size());
+            s->copy(x.data(), y.data());
+            snapshot_.reset(new Snapshot(x, y));
+            snapshot_->cache()->segments(*snapshot_);
+            snapshotVersion_ = s->version();
+        }
+        snapshot_->xSorted = sortedX();
+        return snapshot_->clone();
+    }
+
+private:
+    using Snapshot = DataSeriesAdaptor<QVector<double>>;
+    mutable std::unique_ptr<Snapshot> snapshot_;
+    mutable quint64 snapshotVersion_{0};
+};
+
+// 2-D histogram of a set of points, see QMatPlotWidget::hist2d().
+//
+// The counts are an image of nx x ny bins over the area passed to
+// setArea(), the visible part of the data, which the backend sets on
+// the GUI thread before each frame. Binning runs in parallel over
+// chunks of points, each task counting into its own partial histogram,
+// and the partial histograms are summed at the end. Copies made by
+// clone() only hold the bins, so that the render thread never reads
+// the points.
+class Histogram2D : public AbstractImageAdaptor
+{
+public:
+    Histogram2D(AbstractDataSeriesAdaptor *points, int nx, int ny);
+
+    int rows() const override { return ny_; }
+    int columns() const override { return nx_; }
+    double value(int k) const override { return bins_.counts[k]; }
+    const double *valueData() const override { return bins_.counts.constData(); }
+    QPointF xlim() const override { return QPointF(bins_.area.left(), bins_.area.right()); }
+    QPointF ylim() const override { return QPointF(bins_.area.top(), bins_.area.bottom()); }
+    QPointF zlim() const override { return bins_.zlim; }
+    AbstractImageAdaptor *clone() const override { return new Histogram2D(*this); }
+    void invalidate() override;
+    // extents of the points
+    QRectF extents() const { return extents_; }
+    // count the points over area, unless already done; true if the
+    // values changed
+    bool setArea(const QRectF &area);
+
+private:
+    // counts of the bins over area, NaN for empty bins
+    struct Bins
+    {
+        QRectF area;
+        QVector<double> counts;
+        QPointF zlim{0., 1.};
+    };
+
+    Bins bin(const QRectF &area) const;
+
+    std::shared_ptr<AbstractDataSeriesAdaptor> points_;
+    QRectF extents_;
+    int nx_, ny_;
+    Bins bins_;
+    bool stale_{true}; // points changed since the last binning
 };
 
 class QLineEdit;
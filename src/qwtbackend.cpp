@@ -1,4 +1,5 @@
 #include "qwtbackend.h"
+#include "qwtraster.h"
 
 #include <QDebug>
 
@@ -9,9 +10,12 @@
 #include <QDateTime>
 #include <QDialogButtonBox>
 #include <QFormLayout>
+#include <QHash>
 #include <QLabel>
 #include <QLineEdit>
 #include <QMenu>
+#include <QMutex>
+#include <QPainter>
 #include <QRegularExpression>
 #include <QScreen>
 #include <QSet>
@@ -19,10 +23,10 @@
 #include <QValidator>
 #include <QtMath>
 
-#include <qwt_color_map.h>
+#include <qwt_clipper.h>
 #include <qwt_interval_symbol.h>
 #include <qwt_math.h>
-#include <qwt_matrix_raster_data.h>
+#include <qwt_painter.h>
 #include <qwt_plot.h>
 #include <qwt_plot_canvas.h>
 #include <qwt_plot_curve.h>
@@ -41,7 +45,14 @@
 #include <qwt_series_data.h>
 #include <qwt_symbol.h>
 
+#include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <vector>
 
 class FormattedPicker : public QwtPlotPicker
 {
@@ -88,6 +99,8 @@ protected:
     {
         if (zoomRectIndex() == 0)
         {
+            // the scales may be out of date while a replot is pending
+            plot()->updateAxes();
             setZoomBase(false);
 
             const QRectF &rect = this->scaleRect();
@@ -267,7 +280,27 @@ public:
     }
 };
 
-class DataHelper : public QwtSeriesData<QPointF>
+// Point series that may publish a raw view of its memory
+class SeriesHelper : public QwtSeriesData<QPointF>
+{
+public:
+    virtual bool view(SeriesView &v) const = 0;
+    // the samples as a first part a and a second part b: the view of the
+    // series and an empty b, or the two parts of a ring of doubles, with
+    // x and unit strides (StreamingSeries::views()); false if neither
+    virtual bool views(SeriesView &a, SeriesView &b) const
+    {
+        b = SeriesView();
+        return view(a);
+    }
+    virtual bool segments(QVector<SeriesSegment> &) const { return false; }
+    virtual bool sortedX() const { return false; }
+    virtual void invalidate() = 0;
+    // copy of the data for the render thread, nullptr if not supported
+    virtual SeriesHelper *snapshot() const = 0;
+};
+
+class DataHelper : public SeriesHelper
 {
 public:
     AbstractDataSeriesAdaptor *d;
@@ -285,9 +318,40 @@ public:
     size_t size() const override { return d->size(); }
     QPointF sample(size_t i) const override { return d->sample(i); }
     QRectF boundingRect() const override { return d->boundingRect(); }
+    bool view(SeriesView &v) const override { return d->view(v) && uniformTypes(v); }
+    bool views(SeriesView &a, SeriesView &b) const override
+    {
+        if (const StreamAdaptor *s = dynamic_cast<const StreamAdaptor *>(d))
+        {
+            s->views(a, b);
+            return true;
+        }
+        return SeriesHelper::views(a, b);
+    }
+    bool segments(QVector<SeriesSegment> &s) const override
+    {
+        if (const CachedSeriesAdaptor *c = dynamic_cast<const CachedSeriesAdaptor *>(d))
+        {
+            s = c->cache()->segments(*c);
+            return true;
+        }
+        if (const StreamAdaptor *a = dynamic_cast<const StreamAdaptor *>(d))
+            return a->segments(s);
+        return false;
+    }
+    bool sortedX() const override { return d->sortedX(); }
+    void invalidate() override { d->invalidate(); }
+    SeriesHelper *snapshot() const override
+    {
+        // index the data before copying the cache, once for all snapshots
+        if (const CachedSeriesAdaptor *c = dynamic_cast<const CachedSeriesAdaptor *>(d))
+            c->cache()->segments(*c);
+        AbstractDataSeriesAdaptor *a = d->clone();
+        return a ? new DataHelper(a) : nullptr;
+    }
 };
 
-class ErrorBarSampleHelper : public QwtSeriesData<QPointF>
+class ErrorBarSampleHelper : public SeriesHelper
 {
 public:
     AbstractErrorBarAdaptor *d;
@@ -305,6 +369,25 @@ public:
     size_t size() const override { return d->size(); }
     QPointF sample(size_t i) const override { return d->sample(i); }
     QRectF boundingRect() const override { return d->boundingRect(); } // ??? why not boundingRect
+    bool view(SeriesView &v) const override { return d->view(v) && uniformTypes(v); }
+    bool segments(QVector<SeriesSegment> &s) const override
+    {
+        if (const CachedErrorBarAdaptor *c = dynamic_cast<const CachedErrorBarAdaptor *>(d))
+        {
+            s = c->cache()->segments(*c);
+            return true;
+        }
+        return false;
+    }
+    bool sortedX() const override { return d->sortedX(); }
+    void invalidate() override { d->invalidate(); }
+    SeriesHelper *snapshot() const override
+    {
+        if (const CachedErrorBarAdaptor *c = dynamic_cast<const CachedErrorBarAdaptor *>(d))
+            c->cache()->segments(*c);
+        AbstractErrorBarAdaptor *a = d->clone();
+        return a ? new ErrorBarSampleHelper(a) : nullptr;
+    }
 };
 
 class ErrorBarIntervalHelper : public QwtSeriesData<QwtIntervalSample>
@@ -330,114 +413,404 @@ public:
         return QwtIntervalSample(s.x(), v.x(), v.y());
     }
     QRectF boundingRect() const override { return d->errorBoundingRect(); }
+    // the samples in memory, see SeriesHelper
+    bool view(SeriesView &v) const { return d->view(v) && uniformTypes(v); }
+    bool sortedX() const { return d->sortedX(); }
+    // the runs of samples without NaN, false if not indexed
+    bool segments(QVector<SeriesSegment> &s) const
+    {
+        const CachedErrorBarAdaptor *c = dynamic_cast<const CachedErrorBarAdaptor *>(d);
+        if (c)
+            s = c->cache()->segments(*c);
+        return c;
+    }
+
+    // copy of the data for the render thread, nullptr if not supported
+    ErrorBarIntervalHelper *snapshot() const
+    {
+        if (const CachedErrorBarAdaptor *c = dynamic_cast<const CachedErrorBarAdaptor *>(d))
+            c->cache()->segments(*c);
+        AbstractErrorBarAdaptor *a = d->clone();
+        if (!a)
+            return nullptr;
+        ErrorBarIntervalHelper *h = new ErrorBarIntervalHelper(a);
+        h->owned_.reset(a);
+        return h;
+    }
+
+private:
+    // the adaptor of a snapshot; otherwise owned by the sample helper
+    std::unique_ptr<AbstractErrorBarAdaptor> owned_;
 };
 
-class StairsDataHelper : public QwtSeriesData<QPointF>
+// Spectrogram rendering whole scanlines: values are fetched row by row
+// from ImageHelper, with the data column of each pixel computed once
+// per tile, and colorized by ColorMapHelper::colorize().
+//
+// The rendered image is cached. It is reused as long as the data
+// version, the color map, the scale maps and the image geometry stay
+// the same, e.g. when only other items of the plot changed. Snapshots
+// for the render thread share the cache of their item.
+class ImageSpectrogram : public QwtPlotSpectrogram
 {
 public:
-    AbstractDataSeriesAdaptor *d;
+    explicit ImageSpectrogram(QwtBackend *backend)
+        : cache_(std::make_shared<RenderCache>())
+    {
+        cache_->backend = backend;
+    }
 
-    StairsDataHelper(AbstractDataSeriesAdaptor *a)
-        : d(a)
+    QImage renderImage(const QwtScaleMap &xMap,
+                       const QwtScaleMap &yMap,
+                       const QRectF &area,
+                       const QSize &imageSize) const override
     {
+        const RenderKey key(this, xMap, yMap, area, imageSize);
+        {
+            QMutexLocker lock(&cache_->mutex);
+            if (key.valid && key == cache_->key && !cache_->image.isNull())
+            {
+                ++cache_->backend->imageCacheHits;
+                return cache_->image;
+            }
+        }
+        ++cache_->backend->imageCacheMisses;
+        colorRange(); // before the tiles are rendered in parallel
+        QImage image = QwtPlotSpectrogram::renderImage(xMap, yMap, area, imageSize);
+        QMutexLocker lock(&cache_->mutex);
+        cache_->image = image;
+        cache_->key = key;
+        return image;
     }
-    StairsDataHelper(const StairsDataHelper &other)
-        : d(other.d)
+
+    // images binned over the visible area (hist2d) are binned again
+    // when the area changes; called on the GUI thread before a frame is
+    // drawn or copied for the render thread, see QwtBackend::rebinImages()
+    void rebin(const QRectF &visible)
     {
+        ImageHelper *img = dynamic_cast<ImageHelper *>(data());
+        Histogram2D *h = img ? dynamic_cast<Histogram2D *>(img->d) : nullptr;
+        // the bins are a cache of the view, like the rendered image
+        if (h && h->setArea(visible & h->extents()))
+            img->init();
     }
-    virtual ~StairsDataHelper() { delete d; }
 
-    size_t size() const override { return d->size(); }
-    QPointF sample(size_t i) const override { return d->sample(i); }
-    QRectF boundingRect() const override { return d->boundingRect(); }
-};
+    QRectF boundingRect() const override
+    {
+        const ImageHelper *img = dynamic_cast<const ImageHelper *>(data());
+        const Histogram2D *h = img ? dynamic_cast<const Histogram2D *>(img->d) : nullptr;
+        return h ? h->extents() : QwtPlotSpectrogram::boundingRect();
+    }
 
-struct ImageHelper : public QwtMatrixRasterData
-{
-    AbstractImageAdaptor *d;
-    bool scale;
+    // copy for the render thread, nullptr if the data cannot be copied
+    ImageSpectrogram *snapshot() const
+    {
+        const ImageHelper *img = dynamic_cast<const ImageHelper *>(data());
+        const ColorMapHelper *cmap = dynamic_cast<const ColorMapHelper *>(colorMap());
+        AbstractImageAdaptor *a = img && cmap ? img->d->clone() : nullptr;
+        if (!a)
+            return nullptr;
+        ImageSpectrogram *s = new ImageSpectrogram(cache_);
+        s->setRenderThreadCount(renderThreadCount());
+        s->setColorMap(new ColorMapHelper(*cmap));
+        s->setData(new ImageHelper(*img, a));
+        return s;
+    }
 
-    ImageHelper(AbstractImageAdaptor *a, bool scale)
-        : d(a)
+private:
+    struct RenderKey
+    {
+        bool valid{false};
+        quint64 data{0}, colors{0};
+        double maps[8];
+        const void *transforms[2];
+        QRectF area;
+        QSize size;
+
+        RenderKey() {}
+        RenderKey(const ImageSpectrogram *item,
+                  const QwtScaleMap &xMap,
+                  const QwtScaleMap &yMap,
+                  const QRectF &area,
+                  const QSize &size)
+            : area(area), size(size)
+        {
+            const ImageHelper *img = dynamic_cast<const ImageHelper *>(item->data());
+            const ColorMapHelper *cmap = dynamic_cast<const ColorMapHelper *>(item->colorMap());
+            valid = img && cmap;
+            data = img ? img->version : 0;
+            colors = cmap ? cmap->serial() : 0;
+            const double m[8] = {xMap.s1(), xMap.s2(), xMap.p1(), xMap.p2(),
+                                 yMap.s1(), yMap.s2(), yMap.p1(), yMap.p2()};
+            std::copy(m, m + 8, maps);
+            transforms[0] = xMap.transformation();
+            transforms[1] = yMap.transformation();
+        }
+        bool operator==(const RenderKey &o) const
+        {
+            return data == o.data && colors == o.colors && std::equal(maps, maps + 8, o.maps)
+                   && transforms[0] == o.transforms[0] && transforms[1] == o.transforms[1]
+                   && area == o.area && size == o.size;
+        }
+    };
+
+    struct RenderCache
+    {
+        QMutex mutex;
+        QImage image;
+        RenderKey key;
+        QwtBackend *backend;
+    };
+    std::shared_ptr<RenderCache> cache_;
+
+    explicit ImageSpectrogram(const std::shared_ptr<RenderCache> &cache)
+        : cache_(cache)
     {
-        init();
     }
-    ImageHelper(const ImageHelper &other)
-        : d(other.d), scale(other.scale)
+
+    // the z interval mapped to the colors, see ColorMapHelper::colorRange()
+    QwtInterval colorRange() const
     {
-        init();
+        const QwtInterval range = data() ? data()->interval(Qt::ZAxis) : QwtInterval();
+        const ColorMapHelper *cmap = dynamic_cast<const ColorMapHelper *>(colorMap());
+        const ImageHelper *img = dynamic_cast<const ImageHelper *>(data());
+        if (!cmap || !img || !cmap->logScale() || range.minValue() > 0.)
+            return range;
+        return cmap->colorRange(range, img->positiveMin());
     }
-    virtual ~ImageHelper() { delete d; }
-    void init()
+
+protected:
+    void renderTile(const QwtScaleMap &xMap,
+                    const QwtScaleMap &yMap,
+                    const QRect &tile,
+                    QImage *image) const override
     {
-        QPointF v = d->xlim();
-        setInterval(Qt::XAxis, QwtInterval(v.x(), v.y()));
-        v = d->ylim();
-        setInterval(Qt::YAxis, QwtInterval(v.x(), v.y()));
-        v = d->zlim();
-        setInterval(Qt::ZAxis, QwtInterval(v.x(), v.y()));
+        const ColorMapHelper *cmap = dynamic_cast<const ColorMapHelper *>(colorMap());
+        if (!cmap || !data())
+        {
+            QwtPlotSpectrogram::renderTile(xMap, yMap, tile, image);
+            return;
+        }
 
-        int ncols = d->columns();
-        int nrows = d->rows();
-        QVector<double> m(ncols * nrows);
+        const QwtRasterData *raster = data();
+        const ImageHelper *img = dynamic_cast<const ImageHelper *>(raster);
+        const QwtInterval range = colorRange();
 
-        for (int k = 0; k < m.size(); ++k)
-            m[k] = d->value(k);
+        const int w = tile.width();
+        std::vector<double> tx(w), v(w);
+        std::vector<int> cols(img ? w : 0);
+        for (int i = 0; i < w; ++i)
+        {
+            tx[i] = xMap.invTransform(tile.left() + i);
+            if (img)
+                cols[i] = img->column(tx[i]);
+        }
 
-        setValueMatrix(m, ncols);
+        for (int y = tile.top(); y <= tile.bottom(); ++y)
+        {
+            const double ty = yMap.invTransform(y);
+            if (img)
+                img->scanline(ty, cols.data(), w, v.data());
+            else
+            {
+                for (int i = 0; i < w; ++i)
+                    v[i] = raster->value(tx[i], ty);
+            }
+            QRgb *line = reinterpret_cast<QRgb *>(image->scanLine(y)) + tile.left();
+            cmap->colorize(range, v.data(), w, line);
+        }
     }
 };
 
-class ColorMapHelper : public QwtColorMap
+// Scrolling image of the last depth_ rows of cols_ values.
+//
+// Rows are kept in a ring buffer, together with a ring image holding
+// their colors: appendRow() colorizes only the new row, and draw()
+// blits the ring image in two slices, so that the cost of a new row
+// does not depend on the depth. The newest row is at the top of the
+// item, at y = depth_, older rows scroll down to y = 0.
+//
+// In log color scale with a lower clim <= 0, the colors start at the
+// smallest positive value appended so far: all rows are colorized again
+// when a row lowers it.
+//
+// Snapshots for the render thread draw from copies of the ring image,
+// so that appending never detaches an image in use by a frame. The
+// copies are recycled once their frame is gone, and brought up to date
+// with the rows appended since their last frame.
+class WaterfallItem : public QwtPlotItem
 {
-    QVector<QRgb> map;
-    bool scale_;
-
 public:
-    explicit ColorMapHelper(const QVector<QRgb> &m, bool scale = true)
-        : QwtColorMap(QwtColorMap::RGB), map(m), scale_(scale)
+    static const int Rtti = QwtPlotItem::Rtti_PlotUserItem + 1;
+
+    WaterfallItem(int columns,
+                  int depth,
+                  const QPointF &xlim,
+                  const QPointF &clim,
+                  ColorMapHelper *cmap)
+        : cols_(qMax(columns, 1))
+        , depth_(qMax(depth, 1))
+        , xlim_(xlim)
+        , clim_(clim.x(), clim.y())
+        , cmap_(cmap)
+        , values_(size_t(cols_) * depth_, qQNaN())
+        , image_(cols_, depth_, QImage::Format_ARGB32_Premultiplied)
     {
+        image_.fill(0u);
+        setItemAttribute(QwtPlotItem::AutoScale, true);
     }
 
-    QRgb rgb(const QwtInterval &interval, double value) const override
+    int rtti() const override { return Rtti; }
+
+    QRectF boundingRect() const override
     {
-        if (qIsNaN(value))
-            return 0u;
+        return QRectF(xlim_.x(), 0., xlim_.y() - xlim_.x(), depth_);
+    }
 
-        double v = value;
-        if (scale_)
-        {
-            const double width = interval.width();
-            if (width <= 0.0)
-                return 0u;
+    // copy for the render thread: only what draw() needs
+    WaterfallItem *snapshot() const
+    {
+        WaterfallItem *w = new WaterfallItem(cols_, depth_, xlim_);
+        w->buffer_ = renderBuffer();
+        w->head_ = head_;
+        return w;
+    }
 
-            v = (value - interval.minValue()) / width * map.size();
+    bool appendRow(const double *z, int n)
+    {
+        if (n != cols_)
+            return false;
+        // the ring runs backwards, so that the image rows from head_ on
+        // are in display order, newest first
+        head_ = (head_ + depth_ - 1) % depth_;
+        ++appended_;
+        std::copy(z, z + cols_, values_.begin() + size_t(head_) * cols_);
+        const QwtInterval range = colorRange();
+        for (int i = 0; i < cols_; ++i)
+        {
+            if (z[i] > 0. && z[i] < positive_)
+                positive_ = z[i];
+        }
+        if (colorRange() != range)
+        {
+            recolor();
+            return true;
         }
+        colorizeRow(head_);
+        itemChanged();
+        return true;
+    }
+
+    const ColorMapHelper *colorMap() const { return cmap_.get(); }
+    void setColorMap(ColorMapHelper *cmap)
+    {
+        cmap_.reset(cmap);
+        recolor();
+    }
+    void setClim(const QPointF &clim)
+    {
+        clim_ = QwtInterval(clim.x(), clim.y());
+        recolor();
+    }
 
-        int i = std::floor(v);
-        i = std::min(i, map.size() - 1);
-        i = std::max(i, 0);
-        return map[i];
+    void draw(QPainter *painter,
+              const QwtScaleMap &xMap,
+              const QwtScaleMap &yMap,
+              const QRectF &) const override
+    {
+        const QRectF r = QwtScaleMap::transform(xMap, yMap, boundingRect()).normalized();
+        const double h = r.height() / depth_;
+        const int top = depth_ - head_; // rows [head_, depth_) are drawn first
+        const QImage &image = buffer_ ? buffer_->image : image_;
+
+        painter->save();
+        painter->setRenderHint(QPainter::SmoothPixmapTransform, false);
+        painter->drawImage(QRectF(r.left(), r.top(), r.width(), top * h),
+                           image,
+                           QRectF(0, head_, cols_, top));
+        if (head_ > 0)
+            painter->drawImage(QRectF(r.left(), r.top() + top * h, r.width(), head_ * h),
+                               image,
+                               QRectF(0, 0, cols_, head_));
+        painter->restore();
     }
 
-#if QWT_VERSION >= 0x060200
-    uint colorIndex(int numColors, const QwtInterval &interval, double value) const override
-#else
-    unsigned char colorIndex(const QwtInterval &interval, double value) const override
-#endif
+private:
+    WaterfallItem(int columns, int depth, const QPointF &xlim)
+        : cols_(columns), depth_(depth), xlim_(xlim)
+    {
+    }
+    QwtInterval colorRange() const { return cmap_->colorRange(clim_, positive_); }
+    void colorizeRow(int r)
     {
-        if (qIsNaN(value))
-            return 0u;
+        cmap_->colorize(colorRange(),
+                        values_.data() + size_t(r) * cols_,
+                        cols_,
+                        reinterpret_cast<QRgb *>(image_.scanLine(r)));
+    }
+    void recolor()
+    {
+        ++recolored_;
+        for (int r = 0; r < depth_; ++r)
+            colorizeRow(r);
+        itemChanged();
+    }
 
-        const double width = interval.width();
-        if (width <= 0.0)
-            return 0u;
+    // copy of the ring image for a snapshot, as of appended rows and
+    // recolor() calls
+    struct RenderBuffer
+    {
+        QImage image;
+        quint64 appended{0}, recolored{0};
+    };
 
-        const double ratio = (value - interval.minValue()) / width;
+    // a buffer no frame refers to, brought up to date
+    std::shared_ptr<RenderBuffer> renderBuffer() const
+    {
+        auto it = std::find_if(buffers_.begin(), buffers_.end(), [](const auto &b) {
+            return b.use_count() == 1;
+        });
+        if (it == buffers_.end())
+        {
+            auto b = std::make_shared<RenderBuffer>();
+            b->image = image_.copy();
+            b->appended = appended_;
+            b->recolored = recolored_;
+            buffers_.push_back(b);
+            return b;
+        }
 
-        int i = std::floor(ratio * map.size());
-        return std::min(i, map.size() - 1);
+        RenderBuffer &b = **it;
+        const quint64 rows = appended_ - b.appended;
+        const size_t bpl = size_t(image_.bytesPerLine());
+        if (b.recolored != recolored_ || rows >= quint64(depth_))
+            std::memcpy(b.image.bits(), image_.constBits(), bpl * depth_);
+        else
+        {
+            // the newest rows, from head_ on
+            for (int k = 0; k < int(rows); ++k)
+            {
+                const int r = (head_ + k) % depth_;
+                std::memcpy(b.image.scanLine(r), image_.constScanLine(r), bpl);
+            }
+        }
+        b.appended = appended_;
+        b.recolored = recolored_;
+        return *it;
     }
+
+    int cols_, depth_;
+    QPointF xlim_;
+    QwtInterval clim_;
+    std::unique_ptr<ColorMapHelper> cmap_;
+    std::vector<double> values_; // NaN = no data yet
+    QImage image_;
+    int head_{0};
+    double positive_{std::numeric_limits<double>::infinity()};
+    quint64 appended_{0}, recolored_{0};
+    // copies of image_ for the snapshots, or the one of a snapshot
+    mutable std::vector<std::shared_ptr<RenderBuffer>> buffers_;
+    std::shared_ptr<RenderBuffer> buffer_;
 };
 
 QwtBackend::QwtBackend(QMatPlotWidget *parent)
@@ -451,6 +824,8 @@ QwtBackend::QwtBackend(QMatPlotWidget *parent)
     // cnv->setLineWidth( 1 );
 
     cnv->setStyleSheet("border: 1px solid black; background: white");
+    // paint within replotNow(), so that the stages of a frame can be timed
+    cnv->setPaintAttribute(QwtPlotCanvas::ImmediatePaint, true);
 
     setCanvas(cnv);
 
@@ -511,10 +886,31 @@ QwtBackend::QwtBackend(QMatPlotWidget *parent)
 
     setAutoReplot(true);
 
+    frameTimer_.setSingleShot(true);
+    frameTimer_.setTimerType(Qt::PreciseTimer);
+    connect(&frameTimer_, &QTimer::timeout, this, &QwtBackend::replotNow);
+
     grid_->enableX(mMatPlot_->grid());
     grid_->enableY(mMatPlot_->grid());
 
     connect(this, &QwtBackend::axisClicked, mMatPlot_, &QMatPlotWidget::onAxisClicked);
+    connect(this, &QwtBackend::frameRendered, mMatPlot_, &QMatPlotWidget::frameRendered);
+
+    // one frame at a time per plot
+    renderPool_.setMaxThreadCount(1);
+
+    statsClock_.start();
+    connect(&statsTimer_, &QTimer::timeout, this, [this]() {
+        // nothing new to report if no frame was rendered since
+        if (frameCount_ == statsReported_)
+            return;
+        statsReported_ = frameCount_;
+        emit renderStatsUpdated(renderStats());
+    });
+    connect(this,
+            &QwtBackend::renderStatsUpdated,
+            mMatPlot_,
+            &QMatPlotWidget::renderStatsUpdated);
 }
 
 //
@@ -555,141 +951,1241 @@ static const QwtSymbol::Style qwt_dotstyles[] = {QwtSymbol::Cross,
                                                  QwtSymbol::Hexagon,
                                                  QwtSymbol::NoSymbol};
 
-void QwtBackend::plot(AbstractDataSeriesAdaptor *d, const QMatPlotWidget::LineSpec &opt)
+// Reduce samples [from, to] to at most 4 points per pixel column,
+// appended to poly.
+//
+// Consecutive samples mapping to the same pixel column are replaced by
+// the first, the minimum, the maximum and the last of them (M4),
+// kept in index order. The polyline through the reduced points covers
+// the same pixels as the full one, so the rendering is unchanged,
+// while the polygon is bounded by the canvas width.
+template <class SampleFn>
+static void m4Decimate(SampleFn sample,
+                       const QwtScaleMap &xMap,
+                       const QwtScaleMap &yMap,
+                       int from,
+                       int to,
+                       QPolygonF &poly)
 {
-    QwtPlotCurve *curve = new QwtPlotCurve;
+    QPointF first, last, pmin, pmax;
+    int ifirst = 0, ilast = 0, imin = 0, imax = 0;
+    double col = 0.;
 
-    curve->setRenderHint(QwtPlotItem::RenderAntialiased);
-    curve->setStyle(QwtPlotCurve::Lines);
-    curve->setPen(opt.clr, 0.0, opt.penStyle);
-    if (opt.markerStyle < QMatPlotWidget::LineSpec::nMarkers)
-    {
-        // set a discernible but not very intrusive size for markers
-        // make the marker same color as plot
-        QwtSymbol *symbol = new QwtSymbol(qwt_dotstyles[opt.markerStyle],
-                                          QBrush(Qt::white),
-                                          QPen(opt.clr),
-                                          QSize(4, 4));
-        curve->setSymbol(symbol);
-    }
+    auto flush = [&]() {
+        poly += first;
+        if (imin < imax)
+        {
+            if (imin != ifirst)
+                poly += pmin;
+            if (imax != ilast)
+                poly += pmax;
+        }
+        else if (imax < imin)
+        {
+            if (imax != ifirst)
+                poly += pmax;
+            if (imin != ilast)
+                poly += pmin;
+        }
+        if (ilast != ifirst)
+            poly += last;
+    };
 
-    curve->setData(new DataHelper(d));
+    for (int i = from; i <= to; ++i)
+    {
+        const QPointF s = sample(i);
+        const QPointF p(xMap.transform(s.x()), yMap.transform(s.y()));
+        const double c = std::floor(p.x());
 
-    curve->attach(this);
+        if (i == from || c != col)
+        {
+            if (i != from)
+                flush();
+            col = c;
+            first = last = pmin = pmax = p;
+            ifirst = ilast = imin = imax = i;
+            continue;
+        }
 
-    replot();
+        last = p;
+        ilast = i;
+        if (p.y() < pmin.y())
+        {
+            pmin = p;
+            imin = i;
+        }
+        else if (p.y() > pmax.y())
+        {
+            pmax = p;
+            imax = i;
+        }
+    }
+    if (to >= from)
+        flush();
 }
 
-class MyIntervalCurve : public QwtPlotIntervalCurve
+// Map samples [from, to] to paint device coordinates, appended to poly
+template <class SampleFn>
+static void mapSamples(SampleFn sample,
+                       const QwtScaleMap &xMap,
+                       const QwtScaleMap &yMap,
+                       int from,
+                       int to,
+                       QPolygonF &poly)
 {
-public:
-    QRectF boundingRect() const override
+    const int k = poly.size();
+    poly.resize(k + to - from + 1);
+    QPointF *p = poly.data() + k;
+    for (int i = from; i <= to; ++i, ++p)
     {
-        QRectF rect = QwtPlotSeriesItem::boundingRect();
-        // if (orientation() == Qt::Vertical)
-        //     rect.setRect(rect.y(), rect.x(), rect.height(), rect.width());
-
-        return rect;
+        const QPointF s = sample(i);
+        *p = QPointF(xMap.transform(s.x()), yMap.transform(s.y()));
     }
-};
+}
 
-void QwtBackend::errorbar(AbstractErrorBarAdaptor *d, const QMatPlotWidget::LineSpec &opt)
+// Call f(sample) with the fastest accessor available for the series.
+//
+// If the series publishes a SeriesView the samples are read directly
+// from memory in their stored type, otherwise through the virtual
+// QwtSeriesData::sample(). The history of a full stream is read from
+// its two parts.
+template <class F>
+static auto withSampleAccessor(const QwtSeriesData<QPointF> *series, F f)
 {
-    QwtPlotCurve *curve = new QwtPlotCurve;
-
-    curve->setRenderHint(QwtPlotItem::RenderAntialiased);
-    curve->setStyle(QwtPlotCurve::Lines);
-    curve->setPen(opt.clr, 0.0, opt.penStyle);
-    if (opt.markerStyle < QMatPlotWidget::LineSpec::nMarkers)
+    const SeriesHelper *helper = dynamic_cast<const SeriesHelper *>(series);
+    SeriesView a, b;
+    if (helper && helper->views(a, b))
     {
-        // set a discernible but not very intrusive size for markers
-        // make the marker same color as plot
-        QwtSymbol *symbol = new QwtSymbol(qwt_dotstyles[opt.markerStyle],
-                                          QBrush(Qt::white),
-                                          QPen(opt.clr),
-                                          QSize(4, 4));
-        curve->setSymbol(symbol);
+        if (!b.size)
+            return withSeriesView(a, f);
+        const double *x1 = static_cast<const double *>(a.x);
+        const double *y1 = static_cast<const double *>(a.y);
+        const double *x2 = static_cast<const double *>(b.x);
+        const double *y2 = static_cast<const double *>(b.y);
+        const int n1 = a.size;
+        return f([=](int i) {
+            return i < n1 ? QPointF(x1[i], y1[i]) : QPointF(x2[i - n1], y2[i - n1]);
+        });
     }
+    return f([series](int i) { return series->sample(i); });
+}
 
-    curve->setData(new ErrorBarSampleHelper(d));
+// Markers rendered once into small premultiplied images (sprites),
+// shared by all curves drawn by a thread. Each thread (the GUI and the
+// render thread) keeps its own cache, so that a lookup takes no lock.
+//
+// A sprite is keyed by the symbol style, size, colors and the device
+// pixel ratio it is drawn at. Curves copy sprites instead of drawing
+// an antialiased QwtSymbol path for each point.
+//
+// The cache is bounded by MaxSprites, except for the sprites used by
+// the current and the previous frame (see nextFrame()), which are never
+// evicted: a frame needing more sprites than the bound would otherwise
+// render them all again, every frame.
+class MarkerAtlas
+{
+public:
+    // largest marker size, in pixels
+    static const int MaxSize = 64;
 
-    curve->attach(this);
+    struct Sprite
+    {
+        QImage image;
+        QPoint offset; // of the top left pixel from the marker position
+    };
 
-    MyIntervalCurve *intervalCurve = new MyIntervalCurve;
-    intervalCurve->setStyle(QwtPlotIntervalCurve::NoCurve);
-    intervalCurve->setPen(Qt::white);
+    static Sprite sprite(QwtSymbol::Style style, int size, QRgb pen, QRgb brush, qreal dpr)
+    {
+        const QPair<quint64, quint64> key((quint64(pen) << 32) | brush,
+                                          (quint64(style) << 32) | (quint64(size) << 16)
+                                              | quint64(qRound(dpr * 4)));
+        Cache &c = cache();
+        c.frame = frame().load(std::memory_order_relaxed);
+        auto it = c.sprites.find(key);
+        if (it != c.sprites.end())
+        {
+            it->frame = c.frame;
+            return it->sprite;
+        }
+        // colors come from the user, keep the cache bounded
+        if (c.sprites.size() >= c.limit)
+        {
+            for (it = c.sprites.begin(); it != c.sprites.end();)
+            {
+                if (it->frame + 1 < c.frame)
+                    it = c.sprites.erase(it);
+                else
+                    ++it;
+            }
+            // sweep again once the recent sprites have doubled
+            c.limit = qMax(int(MaxSprites), 2 * c.sprites.size());
+        }
+        Entry e{render(style, size, pen, brush, dpr), c.frame};
+        return c.sprites.insert(key, e)->sprite;
+    }
 
-    QColor c(opt.clr); // skip alpha
+    // a frame starts: the sprites used from now on are kept until the
+    // end of the next frame
+    static void nextFrame() { frame().fetch_add(1, std::memory_order_relaxed); }
 
-    QwtIntervalSymbol *errorBar = new QwtIntervalSymbol(QwtIntervalSymbol::Bar);
-    errorBar->setWidth(8); // should be something even
-    errorBar->setPen(c);
+private:
+    static const int MaxSprites = 4096;
 
-    intervalCurve->setSymbol(errorBar);
-    intervalCurve->setRenderHint(QwtPlotItem::RenderAntialiased, false);
+    struct Entry
+    {
+        Sprite sprite;
+        quint64 frame; // last used
+    };
+    struct Cache
+    {
+        QHash<QPair<quint64, quint64>, Entry> sprites;
+        quint64 frame{1}; // current, as of the last lookup
+        int limit{MaxSprites};
+    };
 
-    intervalCurve->setSamples(new ErrorBarIntervalHelper(d));
-    intervalCurve->attach(this);
+    // frames started, counted for all threads
+    static std::atomic<quint64> &frame()
+    {
+        static std::atomic<quint64> f{1};
+        return f;
+    }
+    static Cache &cache()
+    {
+        static thread_local Cache c;
+        return c;
+    }
 
-    replot();
-}
+    static Sprite render(QwtSymbol::Style style, int size, QRgb pen, QRgb brush, qreal dpr)
+    {
+        // room for the pen and the antialiased edges
+        const int d = qCeil((size + 3) * dpr);
+        Sprite s;
+        s.image = QImage(d, d, QImage::Format_ARGB32_Premultiplied);
+        s.image.fill(Qt::transparent);
+        s.offset = QPoint(-d / 2, -d / 2);
+
+        QPainter p(&s.image);
+        p.setRenderHint(QPainter::Antialiasing);
+        p.scale(dpr, dpr);
+        const QwtSymbol symbol(style,
+                               QBrush(QColor::fromRgba(brush)),
+                               QPen(QColor::fromRgba(pen)),
+                               QSize(size, size));
+        symbol.drawSymbol(&p, QPointF(d / 2, d / 2) / dpr);
+        p.end();
+        s.image.setDevicePixelRatio(dpr);
+        return s;
+    }
+};
 
-void QwtBackend::image(AbstractImageAdaptor *d, bool scale, const QVector<QRgb> &cmap)
+// Sprites of one drawSymbols() call, indexed by size * colors + color.
+//
+// The table is kept per thread and reused by the next calls, so that it
+// is not allocated for each call: begin() starts a call, and the entries
+// filled by earlier calls are stale.
+class SpriteTable
 {
-    QwtPlotSpectrogram *d_spectrogram = new QwtPlotSpectrogram();
-    d_spectrogram->setRenderThreadCount(0); // use system specific thread count
-
-    d_spectrogram->setColorMap(new ColorMapHelper(cmap, scale));
+public:
+    static SpriteTable &begin(int n)
+    {
+        static thread_local SpriteTable t;
+        if (int(t.entries_.size()) < n)
+            t.entries_.resize(n);
+        ++t.call_;
+        return t;
+    }
+    // entry k, null until set in this call
+    MarkerAtlas::Sprite &operator[](int k)
+    {
+        Entry &e = entries_[k];
+        if (e.call != call_)
+        {
+            e.sprite = MarkerAtlas::Sprite();
+            e.call = call_;
+        }
+        return e.sprite;
+    }
 
-    d_spectrogram->setData(new ImageHelper(d, scale));
-    d_spectrogram->attach(this);
+private:
+    struct Entry
+    {
+        MarkerAtlas::Sprite sprite;
+        quint64 call{0};
+    };
+    std::vector<Entry> entries_;
+    quint64 call_{0};
+};
 
-    replot();
+// x * a / 255 for the 4 channels of a premultiplied pixel
+static inline uint byteMul(uint x, uint a)
+{
+    uint t = (x & 0xff00ff) * a;
+    t = (t + ((t >> 8) & 0xff00ff) + 0x800080) >> 8;
+    t &= 0xff00ff;
+    x = ((x >> 8) & 0xff00ff) * a;
+    x = (x + ((x >> 8) & 0xff00ff) + 0x800080);
+    x &= 0xff00ff00;
+    return x | t;
 }
 
-void QwtBackend::setAxisScaling(int axisid, QMatPlotWidget::AxisScale sc)
+// Blend a premultiplied sprite over the layer with its top left pixel
+// at (x, y), clipped to the layer
+static void blendSprite(QImage &layer, const QImage &sprite, int x, int y)
 {
-    switch (sc)
+    const int x1 = qMax(x, 0), x2 = qMin(x + sprite.width(), layer.width());
+    const int y1 = qMax(y, 0), y2 = qMin(y + sprite.height(), layer.height());
+    uchar *bits = layer.bits();
+    const int bpl = layer.bytesPerLine();
+    for (int j = y1; j < y2; ++j)
     {
-    case QMatPlotWidget::Linear:
-        setAxisScaleEngine(axisid, new QwtLinearScaleEngine());
-        setAxisScaleDraw(axisid, new SciScaleDraw());
-        break;
-    case QMatPlotWidget::Log:
-        setAxisScaleEngine(axisid, new QwtLogScaleEngine());
-        setAxisScaleDraw(axisid, new SciScaleDraw());
-        break;
-    case QMatPlotWidget::Time:
-        setAxisScaleEngine(axisid, new TimeScaleEngine());
-        setAxisScaleDraw(axisid, new TimeScaleDraw());
+        QRgb *dst = reinterpret_cast<QRgb *>(bits + j * bpl);
+        const QRgb *src = reinterpret_cast<const QRgb *>(sprite.constScanLine(j - y)) - x;
+        for (int i = x1; i < x2; ++i)
+        {
+            const QRgb c = src[i];
+            const uint a = qAlpha(c);
+            if (a == 255)
+                dst[i] = c;
+            else if (a)
+                dst[i] = c + byteMul(dst[i], 255 - a);
+        }
     }
 }
 
-void QwtBackend::setAxisEqual()
+// Line curve with pixel-aware decimation.
+//
+// When there are many more samples than pixel columns on the canvas,
+// the samples are reduced by m4Decimate() before clipping and painting,
+// so that the rendering cost depends on the canvas width and not on
+// the size of the series. Series with contiguous storage are mapped
+// straight from memory, without a virtual call per sample.
+//
+// The Steps style (stairs plots) goes through the same path: the real
+// samples are mapped or decimated first, and each segment is expanded
+// into a horizontal and a vertical one in pixel coordinates.
+//
+// Curves lying outside of the canvas are not drawn at all. For series
+// with sorted x, only the visible samples and their neighbours on each
+// side are passed on, found by binary search.
+//
+// Lines are broken at NaN samples, as in MATLAB: each run of samples
+// without NaN is drawn as one polyline. The runs come from the index
+// kept by the adaptor (SegmentIndex), so the samples are not checked
+// while drawing. Each run is decimated on its own, so that no stroke
+// crosses a gap, however narrow.
+//
+// Markers are copied from MarkerAtlas sprites. Above LayerThreshold
+// points they are blended into one layer image by blendSprite(), drawn
+// with a single drawImage() call; identical markers falling on the same
+// pixel are blended once. The points of scatter plots have their own
+// sizes and colors (see ScatterMarkers), picking one sprite per size
+// and color map entry.
+class LineCurve : public QwtPlotCurve
 {
-    QSize sz = canvas()->size();
-    double x0 = axisScaleDiv(QwtPlot::xBottom).lowerBound();
-    double x1 = axisScaleDiv(QwtPlot::xBottom).upperBound();
-    double y0 = axisScaleDiv(QwtPlot::yLeft).lowerBound();
-    double y1 = axisScaleDiv(QwtPlot::yLeft).upperBound();
-    double ax = (x1 - x0) / sz.width();
-    double ay = (y1 - y0) / sz.height();
-    if (ay < ax)
-    {
-        double ym = 0.5 * (y0 + y1);
-        double dy = ax * sz.height();
-        setAxisScale(QwtPlot::yLeft, ym - 0.5 * dy, ym + 0.5 * dy);
-    }
-    else if (ax < ay)
+public:
+    // decimate above this number of samples per pixel column
+    static const int DecimationFactor = 4;
+    // blend markers into a layer above this number of points
+    static const int LayerThreshold = 1024;
+
+    // color map of the values of scatter plots
+    void setColorMap(const QVector<QRgb> &cmap) { colorMap_ = cmap; }
+    const QVector<QRgb> &colorMap() const { return colorMap_; }
+
+    void drawSeries(QPainter *painter,
+                    const QwtScaleMap &xMap,
+                    const QwtScaleMap &yMap,
+                    const QRectF &canvasRect,
+                    int from,
+                    int to) const override
     {
-        double xm = 0.5 * (x0 + x1);
-        double dx = ay * sz.width();
-        setAxisScale(QwtPlot::xBottom, xm - 0.5 * dx, xm + 0.5 * dx);
+        if (to < 0)
+            to = int(dataSize()) - 1;
+        from = qMax(from, 0);
+        if (from > to)
+            return;
+
+        // visible area in plot coordinates, with room for pen and symbols
+        qreal m = pen().widthF();
+        if (const QwtSymbol *s = symbol())
+            m = qMax(m, qreal(qMax(s->size().width(), s->size().height())));
+        if (scatterMarkers())
+            m = qMax(m, qreal(MarkerAtlas::MaxSize));
+        m += 1;
+        const QRectF area =
+            QwtScaleMap::invTransform(xMap, yMap, canvasRect.adjusted(-m, -m, m, m)).normalized();
+
+        // sticks and fills reach the baseline outside of the bounding rect
+        const QRectF br = boundingRect();
+        const bool fill = style() == Sticks || brush().style() != Qt::NoBrush;
+        if (br.right() < area.left() || br.left() > area.right()
+            || (!fill && (br.bottom() < area.top() || br.top() > area.bottom())))
+            return;
+
+        const SeriesHelper *helper = dynamic_cast<const SeriesHelper *>(data());
+        if (helper && helper->sortedX())
+        {
+            from = qMax(from, partitionX(from, to + 1, area.left(), false) - 1);
+            to = qMin(to, partitionX(from, to + 1, area.right(), true));
+        }
+
+        QwtPlotCurve::drawSeries(painter, xMap, yMap, canvasRect, from, to);
     }
-}
 
-void QwtBackend::clear()
-{
+protected:
+    void drawLines(QPainter *painter,
+                   const QwtScaleMap &xMap,
+                   const QwtScaleMap &yMap,
+                   const QRectF &canvasRect,
+                   int from,
+                   int to) const override
+    {
+        QVector<QPolygonF> runs;
+        if (!mapRuns(xMap, yMap, canvasRect, from, to, runs))
+        {
+            for (const SeriesSegment &r : segments(from, to))
+            {
+                QwtPlotCurve::drawLines(painter, xMap, yMap, canvasRect, r.from, r.to - 1);
+                countDrawn(r.to - r.from);
+            }
+            return;
+        }
+        for (QPolygonF &polyline : runs)
+            drawPolyline(painter, canvasRect, polyline);
+    }
+
+    void drawSteps(QPainter *painter,
+                   const QwtScaleMap &xMap,
+                   const QwtScaleMap &yMap,
+                   const QRectF &canvasRect,
+                   int from,
+                   int to) const override
+    {
+        QVector<QPolygonF> runs;
+        if (!mapRuns(xMap, yMap, canvasRect, from, to, runs))
+        {
+            for (const SeriesSegment &r : segments(from, to))
+            {
+                QwtPlotCurve::drawSteps(painter, xMap, yMap, canvasRect, r.from, r.to - 1);
+                countDrawn(r.to - r.from);
+            }
+            return;
+        }
+
+        // p[k] -> (x[k+1], y[k]) -> p[k+1], or vertical first if Inverted
+        const bool inverted = testCurveAttribute(Inverted);
+        for (const QPolygonF &points : runs)
+        {
+            QPolygonF polyline(points.isEmpty() ? 0 : 2 * points.size() - 1);
+            QPointF *q = polyline.data();
+            for (int k = 0; k < points.size(); ++k)
+            {
+                if (k > 0)
+                {
+                    const QPointF &p0 = points[k - 1];
+                    const QPointF &p1 = points[k];
+                    *q++ = inverted ? QPointF(p0.x(), p1.y()) : QPointF(p1.x(), p0.y());
+                }
+                *q++ = points[k];
+            }
+            drawPolyline(painter, canvasRect, polyline);
+        }
+    }
+
+    void drawSymbols(QPainter *painter,
+                     const QwtSymbol &symbol,
+                     const QwtScaleMap &xMap,
+                     const QwtScaleMap &yMap,
+                     const QRectF &canvasRect,
+                     int from,
+                     int to) const override
+    {
+        const ScatterMarkers *markers = scatterMarkers();
+        const QPaintEngine *engine = painter->paintEngine();
+        if (!engine || engine->type() != QPaintEngine::Raster
+            || painter->transform().type() > QTransform::TxTranslate
+            || symbol.style() == QwtSymbol::NoSymbol || symbol.style() > QwtSymbol::Hexagon)
+        {
+            // vector output
+            if (markers)
+                drawMarkerShapes(painter, symbol, *markers, xMap, yMap, from, to);
+            else
+                QwtPlotCurve::drawSymbols(painter, symbol, xMap, yMap, canvasRect, from, to);
+            return;
+        }
+
+        const qreal dpr = painter->device()->devicePixelRatioF();
+        const QBrush &b = symbol.brush();
+        const QRgb brush = b.style() == Qt::NoBrush ? 0 : b.color().rgba();
+        const QRgb pen = symbol.pen().color().rgba();
+
+        // sprite of each point: uniform, or per size and color map entry
+        const bool mapped = markers && markers->hasValues() && !colorMap_.isEmpty();
+        const bool uniform = !markers || (markers->uniformArea() && !mapped);
+        const int ncolors = mapped ? colorMap_.size() : 1;
+        double vmin = 0., vmax = 0.;
+        if (mapped)
+            markers->valueRange(vmin, vmax);
+        const double vscale = vmax > vmin ? ncolors / (vmax - vmin) : 0.;
+        SpriteTable &sprites = SpriteTable::begin((MarkerAtlas::MaxSize + 1) * ncolors);
+        auto spriteOf = [&](int i) -> const MarkerAtlas::Sprite * {
+            const int size = markers ? markerSize(markers->area(i))
+                                     : qBound(1, symbol.size().width(), int(MarkerAtlas::MaxSize));
+            int c = 0;
+            if (mapped)
+            {
+                const double v = markers->value(i);
+                if (v != v)
+                    return nullptr;
+                c = qBound(0, int((v - vmin) * vscale), ncolors - 1);
+            }
+            MarkerAtlas::Sprite &s = sprites[size * ncolors + c];
+            if (s.image.isNull())
+            {
+                const QRgb clr = mapped ? colorMap_[c] : pen;
+                s = MarkerAtlas::sprite(symbol.style(), size, clr, brush, dpr);
+            }
+            return &s;
+        };
+
+        const QRect rect = canvasRect.toAlignedRect();
+        const QRectF bounds = QRectF(rect).adjusted(-MarkerAtlas::MaxSize,
+                                                    -MarkerAtlas::MaxSize,
+                                                    MarkerAtlas::MaxSize,
+                                                    MarkerAtlas::MaxSize);
+        const bool layered = to - from + 1 > LayerThreshold;
+        QImage layer;
+        std::vector<bool> seen;
+        if (layered)
+        {
+            layer = QImage(rect.size() * dpr, QImage::Format_ARGB32_Premultiplied);
+            layer.fill(0);
+            if (uniform)
+                seen.resize(size_t(layer.width()) * layer.height());
+        }
+
+        const int blits = withSampleAccessor(data(), [&](auto sample) {
+            int n = 0;
+            for (int i = from; i <= to; ++i)
+            {
+                const QPointF p = sample(i);
+                const double x = xMap.transform(p.x());
+                const double y = yMap.transform(p.y());
+                if (!bounds.contains(x, y))
+                    continue; // also NaN
+                const MarkerAtlas::Sprite *s = spriteOf(i);
+                if (!s)
+                    continue;
+                if (!layered)
+                {
+                    const QPointF at(qRound(x * dpr) + s->offset.x(),
+                                     qRound(y * dpr) + s->offset.y());
+                    painter->drawImage(at / dpr, s->image);
+                    ++n;
+                    continue;
+                }
+                const int cx = qRound((x - rect.left()) * dpr);
+                const int cy = qRound((y - rect.top()) * dpr);
+                if (uniform && cx >= 0 && cy >= 0 && cx < layer.width() && cy < layer.height())
+                {
+                    const size_t k = size_t(cy) * layer.width() + cx;
+                    if (seen[k])
+                        continue;
+                    seen[k] = true;
+                }
+                blendSprite(layer, s->image, cx + s->offset.x(), cy + s->offset.y());
+                ++n;
+            }
+            return n;
+        });
+
+        if (layered)
+        {
+            layer.setDevicePixelRatio(dpr);
+            painter->drawImage(rect.topLeft(), layer);
+        }
+        if (FrameStats *stats = FrameStats::current)
+        {
+            if (style() == NoCurve)
+                stats->submitted += to - from + 1;
+            stats->drawn += blits;
+        }
+    }
+
+private:
+    const ScatterMarkers *scatterMarkers() const
+    {
+        const DataHelper *h = dynamic_cast<const DataHelper *>(data());
+        return h ? dynamic_cast<const ScatterMarkers *>(h->d) : nullptr;
+    }
+
+    // diameter in pixels of a marker of area a
+    static int markerSize(double a)
+    {
+        return a > 0. ? qBound(1, qRound(std::sqrt(a)), int(MarkerAtlas::MaxSize)) : 1;
+    }
+
+    // scatter markers as shapes, one QwtSymbol per point
+    void drawMarkerShapes(QPainter *painter,
+                          const QwtSymbol &symbol,
+                          const ScatterMarkers &markers,
+                          const QwtScaleMap &xMap,
+                          const QwtScaleMap &yMap,
+                          int from,
+                          int to) const
+    {
+        double vmin = 0., vmax = 0.;
+        if (markers.hasValues())
+            markers.valueRange(vmin, vmax);
+        const int ncolors = colorMap_.size();
+        const double vscale = vmax > vmin ? ncolors / (vmax - vmin) : 0.;
+        for (int i = from; i <= to; ++i)
+        {
+            QPen pen = symbol.pen();
+            if (markers.hasValues() && ncolors)
+            {
+                const double v = markers.value(i);
+                if (v != v)
+                    continue;
+                pen.setColor(QColor(colorMap_[qBound(0, int((v - vmin) * vscale), ncolors - 1)]));
+            }
+            const int size = markerSize(markers.area(i));
+            const QwtSymbol s(symbol.style(), symbol.brush(), pen, QSize(size, size));
+            const QPointF p = sample(i);
+            s.drawSymbol(painter, QPointF(xMap.transform(p.x()), yMap.transform(p.y())));
+        }
+    }
+
+    QVector<QRgb> colorMap_;
+
+    // Map the runs of samples without NaN in [from, to] to pixel
+    // coordinates into polylines, decimated if dense. Returns false if
+    // the curve has to be drawn by QwtPlotCurve instead.
+    bool mapRuns(const QwtScaleMap &xMap,
+                 const QwtScaleMap &yMap,
+                 const QRectF &canvasRect,
+                 int from,
+                 int to,
+                 QVector<QPolygonF> &runs) const
+    {
+        const int columns = qCeil(canvasRect.width());
+        const bool decimate = to - from + 1 > DecimationFactor * columns;
+        if (FrameStats *stats = FrameStats::current)
+            stats->submitted += to - from + 1;
+        SeriesView a, b;
+        const SeriesHelper *helper = dynamic_cast<const SeriesHelper *>(data());
+        if ((!decimate && !(helper && helper->views(a, b))) || testCurveAttribute(Fitted)
+            || brush().style() != Qt::NoBrush)
+            return false;
+
+        const QVector<SeriesSegment> segs = segments(from, to);
+        withSampleAccessor(data(), [&](auto sample) {
+            runs.reserve(segs.size());
+            for (const SeriesSegment &r : segs)
+            {
+                // one polyline per run: the line is broken at every gap
+                QPolygonF poly;
+                if (decimate)
+                    m4Decimate(sample, xMap, yMap, r.from, r.to - 1, poly);
+                else
+                {
+                    poly.reserve(r.to - r.from);
+                    mapSamples(sample, xMap, yMap, r.from, r.to - 1, poly);
+                }
+                if (!poly.isEmpty())
+                    runs += poly;
+            }
+        });
+        return true;
+    }
+
+    // The runs of samples in [from, to] without NaN, from the index of
+    // the series, or found by checking each sample if it has none
+    QVector<SeriesSegment> segments(int from, int to) const
+    {
+        QVector<SeriesSegment> all, runs;
+        const SeriesHelper *helper = dynamic_cast<const SeriesHelper *>(data());
+        if (!helper || !helper->segments(all))
+        {
+            withSampleAccessor(data(), [&](auto sample) {
+                appendSegments(
+                    from,
+                    to + 1,
+                    [&sample](int i) {
+                        const QPointF p = sample(i);
+                        return qIsNaN(p.x()) || qIsNaN(p.y());
+                    },
+                    runs);
+            });
+            return runs;
+        }
+
+        // the runs overlapping [from, to], clipped
+        auto it = std::partition_point(all.cbegin(), all.cend(), [from](const SeriesSegment &r) {
+            return r.to <= from;
+        });
+        for (; it != all.cend() && it->from <= to; ++it)
+            runs += SeriesSegment{qMax(it->from, from), qMin(it->to, to + 1)};
+        return runs;
+    }
+
+    void drawPolyline(QPainter *painter, const QRectF &canvasRect, QPolygonF &polyline) const
+    {
+        if (QwtPainter::roundingAlignment(painter))
+        {
+            for (QPointF &p : polyline)
+                p = QPointF(qRound(p.x()), qRound(p.y()));
+        }
+
+        if (testPaintAttribute(ClipPolygons))
+        {
+            const qreal pw = qMax(qreal(1.), painter->pen().widthF());
+            const QRectF clipRect = canvasRect.adjusted(-pw, -pw, pw, pw);
+            polyline = QwtClipper::clipPolygonF(clipRect, polyline, false);
+        }
+
+        countDrawn(polyline.size());
+        QwtPainter::drawPolyline(painter, polyline);
+    }
+
+    // first sample in [lo, hi) with x >= v, or x > v if after
+    int partitionX(int lo, int hi, double v, bool after) const
+    {
+        while (lo < hi)
+        {
+            const int mid = lo + (hi - lo) / 2;
+            const double x = sample(mid).x();
+            if (x < v || (after && x == v))
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        return lo;
+    }
+
+    static void countDrawn(int n)
+    {
+        if (FrameStats *stats = FrameStats::current)
+            stats->drawn += n;
+    }
+};
+
+// Set the pen and marker of a curve
+static void setCurveStyle(QwtPlotCurve *curve, const QMatPlotWidget::LineSpec &opt)
+{
+    curve->setPen(opt.clr, 0.0, opt.penStyle);
+    // scatter plots have only markers, hollow as in MATLAB
+    const bool scatter = curve->style() == QwtPlotCurve::NoCurve;
+    int marker = opt.markerStyle;
+    if (scatter && marker == QMatPlotWidget::LineSpec::nMarkers)
+        marker = 1; // 'o'
+    if (marker < QMatPlotWidget::LineSpec::nMarkers)
+    {
+        // set a discernible but not very intrusive size for markers
+        // make the marker same color as plot
+        QwtSymbol *symbol = new QwtSymbol(qwt_dotstyles[marker],
+                                          scatter ? QBrush() : QBrush(Qt::white),
+                                          QPen(opt.clr),
+                                          QSize(4, 4));
+        curve->setSymbol(symbol);
+    }
+    else
+        curve->setSymbol(nullptr);
+}
+
+// Set the color of the error bars
+static void setBarsColor(QwtPlotIntervalCurve *bars, const QColor &clr)
+{
+    QColor c(clr); // skip alpha
+
+    QwtIntervalSymbol *errorBar = new QwtIntervalSymbol(QwtIntervalSymbol::Bar);
+    errorBar->setWidth(8); // should be something even
+    errorBar->setPen(c);
+
+    bars->setSymbol(errorBar);
+}
+
+int QwtBackend::plot(AbstractDataSeriesAdaptor *d, const QMatPlotWidget::LineSpec &opt)
+{
+    QwtPlotCurve *curve = new LineCurve;
+
+    curve->setRenderHint(QwtPlotItem::RenderAntialiased);
+    curve->setStyle(d->steps() ? QwtPlotCurve::Steps : QwtPlotCurve::Lines);
+    setCurveStyle(curve, opt);
+
+    curve->setData(new DataHelper(d));
+
+    curve->attach(this);
+
+    replot();
+
+    return addItem(curve);
+}
+
+int QwtBackend::scatter(AbstractDataSeriesAdaptor *d,
+                        const QMatPlotWidget::LineSpec &opt,
+                        const QVector<QRgb> &cmap)
+{
+    LineCurve *curve = new LineCurve;
+
+    curve->setRenderHint(QwtPlotItem::RenderAntialiased);
+    curve->setStyle(QwtPlotCurve::NoCurve);
+    curve->setColorMap(cmap);
+    setCurveStyle(curve, opt);
+
+    curve->setData(new DataHelper(d));
+
+    curve->attach(this);
+
+    replot();
+
+    return addItem(curve);
+}
+
+// Error bars.
+//
+// Dense series are drawn as an envelope: when there are more visible
+// samples than DenseFactor per pixel column, the intervals falling in
+// each column are merged into their min/max, drawn as a single bar per
+// column with one drawLines() call, instead of one symbol per sample.
+// As for LineCurve, x is read from the memory of the series if it is
+// published, the visible samples of sorted series are found by binary
+// search, and the runs of samples with NaN are skipped.
+class MyIntervalCurve : public QwtPlotIntervalCurve
+{
+public:
+    // envelope above this number of visible samples per pixel column,
+    // the density above which the line of the series is decimated:
+    // below it the bars of the samples are still told apart
+    static const int DenseFactor = LineCurve::DecimationFactor;
+
+    QRectF boundingRect() const override
+    {
+        QRectF rect = QwtPlotSeriesItem::boundingRect();
+        // if (orientation() == Qt::Vertical)
+        //     rect.setRect(rect.y(), rect.x(), rect.height(), rect.width());
+
+        return rect;
+    }
+
+protected:
+    void drawSeries(QPainter *painter,
+                    const QwtScaleMap &xMap,
+                    const QwtScaleMap &yMap,
+                    const QRectF &canvasRect,
+                    int from,
+                    int to) const override
+    {
+        if (to < 0)
+            to = int(dataSize()) - 1;
+        from = qMax(from, 0);
+        if (from > to || !symbol() || orientation() != Qt::Vertical
+            || !drawEnvelope(painter, xMap, yMap, canvasRect, from, to))
+            QwtPlotIntervalCurve::drawSeries(painter, xMap, yMap, canvasRect, from, to);
+    }
+
+private:
+    // draw the envelope of the samples [from, to], or return false if
+    // they are not dense enough
+    bool drawEnvelope(QPainter *painter,
+                      const QwtScaleMap &xMap,
+                      const QwtScaleMap &yMap,
+                      const QRectF &canvasRect,
+                      int from,
+                      int to) const
+    {
+        const int columns = qCeil(canvasRect.width());
+        const ErrorBarIntervalHelper *h = dynamic_cast<const ErrorBarIntervalHelper *>(data());
+        if (!h || to - from + 1 <= DenseFactor * columns)
+            return false;
+
+        // x read from memory if possible, as by LineCurve
+        SeriesView v;
+        if (h->view(v))
+            return withSeriesView(v, [&](auto sample) {
+                return drawEnvelope(painter, xMap, yMap, canvasRect, from, to, *h, sample);
+            });
+        const AbstractErrorBarAdaptor *d = h->d;
+        return drawEnvelope(painter, xMap, yMap, canvasRect, from, to, *h, [d](int i) {
+            return d->sample(i);
+        });
+    }
+
+    template <class SampleFn>
+    bool drawEnvelope(QPainter *painter,
+                      const QwtScaleMap &xMap,
+                      const QwtScaleMap &yMap,
+                      const QRectF &canvasRect,
+                      int from,
+                      int to,
+                      const ErrorBarIntervalHelper &h,
+                      SampleFn sample) const
+    {
+        const int columns = qCeil(canvasRect.width());
+        const double left = canvasRect.left();
+
+        // sorted x: only the samples of the visible columns, found by
+        // binary search
+        if (h.sortedX())
+        {
+            const double x1 = xMap.invTransform(left), x2 = xMap.invTransform(left + columns);
+            auto partition = [&sample](int lo, int hi, double v, bool after) {
+                while (lo < hi)
+                {
+                    const int mid = lo + (hi - lo) / 2;
+                    const double x = sample(mid).x();
+                    if (x < v || (after && x == v))
+                        lo = mid + 1;
+                    else
+                        hi = mid;
+                }
+                return lo;
+            };
+            from = partition(from, to + 1, std::min(x1, x2), false);
+            to = partition(from, to + 1, std::max(x1, x2), true) - 1;
+            if (to - from + 1 <= DenseFactor * columns)
+                return false;
+        }
+
+        // the runs without NaN overlapping [from, to]
+        QVector<SeriesSegment> runs;
+        if (!h.segments(runs))
+            runs += SeriesSegment{from, to + 1};
+        auto run = std::partition_point(runs.cbegin(), runs.cend(), [from](const SeriesSegment &r) {
+            return r.to <= from;
+        });
+
+        // min/max of the interval bounds by column, in data coordinates
+        const double inf = std::numeric_limits<double>::infinity();
+        std::vector<double> lo(columns, inf), hi(columns, -inf);
+        int visible = 0;
+        for (; run != runs.cend() && run->from <= to; ++run)
+        {
+            const int end = std::min(run->to, to + 1);
+            for (int i = std::max(run->from, from); i < end; ++i)
+            {
+                const double px = xMap.transform(sample(i).x()) - left;
+                if (!(px >= 0. && px < columns))
+                    continue;
+                const int c = int(px);
+                const QPointF bounds = h.d->interval(i);
+                lo[c] = std::min(lo[c], bounds.x());
+                hi[c] = std::max(hi[c], bounds.y());
+                ++visible;
+            }
+        }
+        if (visible <= DenseFactor * columns)
+            return false;
+
+        QVector<QLineF> bars;
+        bars.reserve(columns);
+        for (int c = 0; c < columns; ++c)
+        {
+            // NaN bounds were skipped by min/max, empty columns stay inverted
+            if (!(lo[c] <= hi[c]))
+                continue;
+            const double x = left + c + 0.5;
+            bars << QLineF(x, yMap.transform(lo[c]), x, yMap.transform(hi[c]));
+        }
+
+        if (FrameStats *stats = FrameStats::current)
+        {
+            stats->submitted += to - from + 1;
+            stats->drawn += bars.size();
+        }
+
+        QPen pen = symbol()->pen();
+        pen.setWidth(0);
+        painter->setPen(pen);
+        painter->drawLines(bars);
+        return true;
+    }
+};
+
+int QwtBackend::errorbar(AbstractErrorBarAdaptor *d, const QMatPlotWidget::LineSpec &opt)
+{
+    QwtPlotCurve *curve = new LineCurve;
+
+    curve->setRenderHint(QwtPlotItem::RenderAntialiased);
+    curve->setStyle(QwtPlotCurve::Lines);
+    setCurveStyle(curve, opt);
+
+    curve->setData(new ErrorBarSampleHelper(d));
+
+    curve->attach(this);
+
+    MyIntervalCurve *intervalCurve = new MyIntervalCurve;
+    intervalCurve->setStyle(QwtPlotIntervalCurve::NoCurve);
+    intervalCurve->setPen(Qt::white);
+
+    setBarsColor(intervalCurve, opt.clr);
+    intervalCurve->setRenderHint(QwtPlotItem::RenderAntialiased, false);
+
+    intervalCurve->setSamples(new ErrorBarIntervalHelper(d));
+    intervalCurve->attach(this);
+
+    replot();
+
+    return addItem(curve, intervalCurve);
+}
+
+int QwtBackend::image(AbstractImageAdaptor *d, bool scale, const QVector<QRgb> &cmap)
+{
+    QwtPlotSpectrogram *d_spectrogram = new ImageSpectrogram(this);
+    d_spectrogram->setRenderThreadCount(0); // use system specific thread count
+
+    d_spectrogram->setColorMap(new ColorMapHelper(cmap, scale, logColors_));
+
+    d_spectrogram->setData(new ImageHelper(d, scale));
+    d_spectrogram->attach(this);
+
+    replot();
+
+    return addItem(d_spectrogram);
+}
+
+int QwtBackend::waterfall(int columns,
+                          int depth,
+                          const QPointF &xlim,
+                          const QPointF &clim,
+                          const QVector<QRgb> &cmap)
+{
+    WaterfallItem *item
+        = new WaterfallItem(columns, depth, xlim, clim, new ColorMapHelper(cmap, true, logColors_));
+    item->attach(this);
+
+    replot();
+
+    return addItem(item);
+}
+
+bool QwtBackend::appendRow(int id, const double *z, int n)
+{
+    QwtPlotItem *item = items_.value(id).item;
+    if (!item || item->rtti() != WaterfallItem::Rtti)
+        return false;
+    return static_cast<WaterfallItem *>(item)->appendRow(z, n);
+}
+
+void QwtBackend::setClim(int id, const QPointF &clim)
+{
+    QwtPlotItem *item = items_.value(id).item;
+    if (item && item->rtti() == WaterfallItem::Rtti)
+        static_cast<WaterfallItem *>(item)->setClim(clim);
+}
+
+int QwtBackend::addItem(QwtPlotItem *item, QwtPlotItem *bars)
+{
+    items_.insert(++lastId_, {item, bars});
+    itemIds_.insert(item, lastId_);
+    if (bars)
+        itemIds_.insert(bars, lastId_);
+    return lastId_;
+}
+
+AbstractDataSeriesAdaptor *QwtBackend::seriesAdaptor(int id) const
+{
+    QwtPlotItem *item = items_.value(id).item;
+    if (!item || item->rtti() != QwtPlotItem::Rtti_PlotCurve)
+        return nullptr;
+    DataHelper *h = dynamic_cast<DataHelper *>(static_cast<QwtPlotCurve *>(item)->data());
+    return h ? h->d : nullptr;
+}
+
+AbstractErrorBarAdaptor *QwtBackend::errorBarAdaptor(int id) const
+{
+    QwtPlotItem *item = items_.value(id).item;
+    if (!item || item->rtti() != QwtPlotItem::Rtti_PlotCurve)
+        return nullptr;
+    ErrorBarSampleHelper *h = dynamic_cast<ErrorBarSampleHelper *>(
+        static_cast<QwtPlotCurve *>(item)->data());
+    return h ? h->d : nullptr;
+}
+
+AbstractImageAdaptor *QwtBackend::imageAdaptor(int id) const
+{
+    QwtPlotItem *item = items_.value(id).item;
+    if (!item || item->rtti() != QwtPlotItem::Rtti_PlotSpectrogram)
+        return nullptr;
+    ImageHelper *h = dynamic_cast<ImageHelper *>(static_cast<QwtPlotSpectrogram *>(item)->data());
+    return h ? h->d : nullptr;
+}
+
+// Replace the adaptor of a curve; the curve, its style and its data
+// helper are kept
+void QwtBackend::setSeriesAdaptor(int id, AbstractDataSeriesAdaptor *d)
+{
+    QwtPlotItem *item = items_.value(id).item;
+    QwtPlotCurve *curve = nullptr;
+    DataHelper *h = nullptr;
+    if (item && item->rtti() == QwtPlotItem::Rtti_PlotCurve)
+    {
+        curve = static_cast<QwtPlotCurve *>(item);
+        h = dynamic_cast<DataHelper *>(curve->data());
+    }
+    if (!h)
+    {
+        delete d;
+        return;
+    }
+    // declared with PlotHandle::setSortedX() for the item
+    d->xSorted = d->xSorted || h->d->xSorted;
+    d->xScale = h->d->xScale;
+    d->yScale = h->d->yScale;
+    delete h->d;
+    h->d = d;
+    if (curve->style() != QwtPlotCurve::NoCurve) // scatter plots stay so
+        curve->setStyle(d->steps() ? QwtPlotCurve::Steps : QwtPlotCurve::Lines);
+    item->itemChanged();
+}
+
+void QwtBackend::setErrorBarAdaptor(int id, AbstractErrorBarAdaptor *d)
+{
+    const PlotItem rec = items_.value(id);
+    ErrorBarSampleHelper *h = nullptr;
+    if (rec.item && rec.bars)
+        h = dynamic_cast<ErrorBarSampleHelper *>(static_cast<QwtPlotCurve *>(rec.item)->data());
+    if (!h)
+    {
+        delete d;
+        return;
+    }
+    d->xScale = h->d->xScale;
+    d->yScale = h->d->yScale;
+    // the adaptor is shared with the bars and owned by the curve
+    QwtPlotIntervalCurve *bars = static_cast<QwtPlotIntervalCurve *>(rec.bars);
+    static_cast<ErrorBarIntervalHelper *>(bars->data())->d = d;
+    delete h->d;
+    h->d = d;
+    rec.item->itemChanged();
+}
+
+// The data of an item were replaced or modified in place
+void QwtBackend::itemDataChanged(int id)
+{
+    const PlotItem rec = items_.value(id);
+    if (!rec.item)
+        return;
+    if (rec.item->rtti() == QwtPlotItem::Rtti_PlotSpectrogram)
+    {
+        if (ImageHelper *h = dynamic_cast<ImageHelper *>(
+                static_cast<QwtPlotSpectrogram *>(rec.item)->data()))
+            h->changed();
+    }
+    else if (SeriesHelper *h = dynamic_cast<SeriesHelper *>(
+                 static_cast<QwtPlotCurve *>(rec.item)->data()))
+        h->invalidate();
+    rec.item->itemChanged();
+}
+
+void QwtBackend::setItemStyle(int id, const QMatPlotWidget::LineSpec &opt)
+{
+    const PlotItem rec = items_.value(id);
+    if (!rec.item || rec.item->rtti() != QwtPlotItem::Rtti_PlotCurve)
+        return;
+    QwtPlotCurve *curve = static_cast<QwtPlotCurve *>(rec.item);
+    QMatPlotWidget::LineSpec l(opt);
+    if (!l.clr.isValid())
+        l.clr = curve->pen().color();
+    setCurveStyle(curve, l);
+    if (rec.bars)
+        setBarsColor(static_cast<QwtPlotIntervalCurve *>(rec.bars), l.clr);
+}
+
+void QwtBackend::setItemColor(int id, const QColor &clr)
+{
+    const PlotItem rec = items_.value(id);
+    if (!rec.item || rec.item->rtti() != QwtPlotItem::Rtti_PlotCurve)
+        return;
+    QwtPlotCurve *curve = static_cast<QwtPlotCurve *>(rec.item);
+    QPen pen = curve->pen();
+    pen.setColor(clr);
+    curve->setPen(pen);
+    if (const QwtSymbol *s = curve->symbol())
+        curve->setSymbol(new QwtSymbol(s->style(), s->brush(), QPen(clr), s->size()));
+    if (rec.bars)
+        setBarsColor(static_cast<QwtPlotIntervalCurve *>(rec.bars), clr);
+}
+
+void QwtBackend::setItemVisible(int id, bool on)
+{
+    const PlotItem rec = items_.value(id);
+    if (rec.item)
+        rec.item->setVisible(on);
+    if (rec.bars)
+        rec.bars->setVisible(on);
+}
+
+void QwtBackend::removeItem(int id)
+{
+    const PlotItem rec = items_.take(id);
+    itemIds_.remove(rec.item);
+    itemIds_.remove(rec.bars);
+    // the bars share the adaptor owned by the curve: delete them first
+    delete rec.bars;
+    delete rec.item;
+}
+
+void QwtBackend::setAxisScaling(int axisid, QMatPlotWidget::AxisScale sc)
+{
+    switch (sc)
+    {
+    case QMatPlotWidget::Linear:
+        setAxisScaleEngine(axisid, new QwtLinearScaleEngine());
+        setAxisScaleDraw(axisid, new SciScaleDraw());
+        break;
+    case QMatPlotWidget::Log:
+        setAxisScaleEngine(axisid, new QwtLogScaleEngine());
+        setAxisScaleDraw(axisid, new SciScaleDraw());
+        break;
+    case QMatPlotWidget::Time:
+        setAxisScaleEngine(axisid, new TimeScaleEngine());
+        setAxisScaleDraw(axisid, new TimeScaleDraw());
+    }
+}
+
+void QwtBackend::setColorScale(QMatPlotWidget::AxisScale sc)
+{
+    logColors_ = sc == QMatPlotWidget::Log;
+    for (QwtPlotItem *item : itemList(QwtPlotItem::Rtti_PlotSpectrogram))
+    {
+        QwtPlotSpectrogram *s = static_cast<QwtPlotSpectrogram *>(item);
+        if (const ColorMapHelper *c = dynamic_cast<const ColorMapHelper *>(s->colorMap()))
+            s->setColorMap(new ColorMapHelper(c->colors(), c->scaled(), logColors_));
+    }
+    for (QwtPlotItem *item : itemList(WaterfallItem::Rtti))
+    {
+        WaterfallItem *w = static_cast<WaterfallItem *>(item);
+        w->setColorMap(new ColorMapHelper(w->colorMap()->colors(), true, logColors_));
+    }
+}
+
+void QwtBackend::setAxisEqual()
+{
+    flushAxes();
+    QSize sz = canvas()->size();
+    double x0 = axisScaleDiv(QwtPlot::xBottom).lowerBound();
+    double x1 = axisScaleDiv(QwtPlot::xBottom).upperBound();
+    double y0 = axisScaleDiv(QwtPlot::yLeft).lowerBound();
+    double y1 = axisScaleDiv(QwtPlot::yLeft).upperBound();
+    double ax = (x1 - x0) / sz.width();
+    double ay = (y1 - y0) / sz.height();
+    if (ay < ax)
+    {
+        double ym = 0.5 * (y0 + y1);
+        double dy = ax * sz.height();
+        setAxisScale(QwtPlot::yLeft, ym - 0.5 * dy, ym + 0.5 * dy);
+    }
+    else if (ax < ay)
+    {
+        double xm = 0.5 * (x0 + x1);
+        double dx = ay * sz.width();
+        setAxisScale(QwtPlot::xBottom, xm - 0.5 * dx, xm + 0.5 * dx);
+    }
+}
+
+void QwtBackend::clear()
+{
     // Rtti_PlotItem = 0 , Rtti_PlotGrid , Rtti_PlotScale , Rtti_PlotLegend ,
     //     Rtti_PlotMarker , Rtti_PlotCurve , Rtti_PlotSpectroCurve , Rtti_PlotIntervalCurve ,
     //     Rtti_PlotHistogram , Rtti_PlotSpectrogram , Rtti_PlotGraphic , Rtti_PlotTradingCurve ,
@@ -700,12 +2196,580 @@ void QwtBackend::clear()
     detachItems(QwtPlotItem::Rtti_PlotIntervalCurve, true);
     detachItems(QwtPlotItem::Rtti_PlotCurve, true);
     detachItems(QwtPlotItem::Rtti_PlotSpectrogram, true);
+    detachItems(WaterfallItem::Rtti, true);
+    items_.clear();
+    itemIds_.clear();
+
+    replot();
+}
+
+thread_local FrameStats *FrameStats::current = nullptr;
+
+static double msecs(const QElapsedTimer &t)
+{
+    return t.nsecsElapsed() * 1e-6;
+}
+
+// Schedule a replot.
+//
+// All replot requests, explicit or from autoReplot, end up here. They
+// are merged into a single frame, rendered from the event loop at most
+// once per display refresh (or per 1/maxFps_ seconds).
+void QwtBackend::replot()
+{
+    ++replotRequests_;
+    if (updateDepth_)
+    {
+        // render once when the transaction commits
+        if (deferredReplot_)
+            ++mergedReplots_;
+        deferredReplot_ = true;
+        return;
+    }
+    if (replotPending_)
+    {
+        ++mergedReplots_;
+        return;
+    }
+    replotPending_ = true;
+
+    // wait until one frame period after the previous frame
+    int wait = 0;
+    if (frameClock_.isValid())
+        wait = qMax(0, qCeil(1000. / frameRate()) - int(frameClock_.elapsed()));
+    frameTimer_.start(wait);
+}
+
+// Render the pending frame, if any, immediately
+void QwtBackend::replotNow()
+{
+    if (!replotPending_)
+        return;
+    frameTimer_.stop();
+    replotPending_ = false;
+    if (updateDepth_)
+    {
+        deferredReplot_ = true;
+        return;
+    }
+
+    QElapsedTimer t;
+    t.start();
+    drainStreams();
+    ++frameSerial_;
+    MarkerAtlas::nextFrame();
+    if (threaded_ && submitFrame(t))
+    {
+        // counted when the frame is shown, see frameReady()
+        frameClock_.start();
+        return;
+    }
+
+    shownSerial_ = frameSerial_;
+    frame_ = QImage();
+
+    // as QwtPlot::replot(), timing each stage; the items are drawn by
+    // drawItems()
+    FrameStats stats;
+    stats.itemTimes = statsInterval_ > 0;
+    const bool doAutoReplot = autoReplot();
+    setAutoReplot(false);
+    double t0 = msecs(t);
+    updateAxes();
+    double t1 = msecs(t);
+    stats.autoscale = t1 - t0;
+    QCoreApplication::sendPostedEvents(this, QEvent::LayoutRequest);
+    rebinImages();
+    t0 = t1;
+    t1 = msecs(t);
+    stats.layout = t1 - t0;
+    FrameStats::current = &stats;
+    static_cast<QwtPlotCanvas *>(canvas())->replot();
+    FrameStats::current = nullptr;
+    stats.total = msecs(t);
+    stats.blit = stats.total - t1 - stats.draw;
+    setAutoReplot(doAutoReplot);
+
+    frameClock_.start();
+    ++frameCount_;
+    frameDone(stats);
+    emit frameRendered();
+}
+
+// Commit an update transaction started with beginUpdate().
+//
+// The layout and replot requests made during the transaction were
+// deferred; they are carried out once here, when the outermost
+// transaction ends.
+void QwtBackend::endUpdate()
+{
+    if (updateDepth_ == 0 || --updateDepth_ > 0)
+        return;
+    if (deferredLayout_)
+    {
+        deferredLayout_ = false;
+        QwtPlot::updateLayout();
+    }
+    if (deferredReplot_)
+    {
+        deferredReplot_ = false;
+        replot();
+    }
+}
+
+void QwtBackend::updateLayout()
+{
+    if (updateDepth_)
+    {
+        deferredLayout_ = true;
+        return;
+    }
+    QwtPlot::updateLayout();
+}
+
+/*---- Threaded rendering -------*/
+
+// Copy the attributes common to all items
+static void copyItemAttributes(const QwtPlotItem *from, QwtPlotItem *to)
+{
+    to->setZ(from->z());
+    to->setAxes(from->xAxis(), from->yAxis());
+    to->setRenderHint(QwtPlotItem::RenderAntialiased,
+                      from->testRenderHint(QwtPlotItem::RenderAntialiased));
+}
+
+static QwtPlotItem *snapshotCurve(const QwtPlotCurve *curve)
+{
+    const SeriesHelper *h = dynamic_cast<const SeriesHelper *>(curve->data());
+    SeriesHelper *data = h ? h->snapshot() : nullptr;
+    if (!data)
+        return nullptr;
+
+    LineCurve *c = new LineCurve;
+    if (const LineCurve *l = dynamic_cast<const LineCurve *>(curve))
+        c->setColorMap(l->colorMap());
+    c->setPen(curve->pen());
+    c->setBrush(curve->brush());
+    c->setStyle(curve->style());
+    c->setBaseline(curve->baseline());
+    if (const QwtSymbol *s = curve->symbol())
+        c->setSymbol(new QwtSymbol(s->style(), s->brush(), s->pen(), s->size()));
+    c->setData(data);
+    return c;
+}
+
+static QwtPlotItem *snapshotBars(const QwtPlotIntervalCurve *bars)
+{
+    const ErrorBarIntervalHelper *h = dynamic_cast<const ErrorBarIntervalHelper *>(bars->data());
+    ErrorBarIntervalHelper *data = h ? h->snapshot() : nullptr;
+    if (!data)
+        return nullptr;
+
+    QwtPlotIntervalCurve *c = new MyIntervalCurve;
+    c->setStyle(bars->style());
+    c->setPen(bars->pen());
+    c->setBrush(bars->brush());
+    if (const QwtIntervalSymbol *s = bars->symbol())
+    {
+        QwtIntervalSymbol *symbol = new QwtIntervalSymbol(s->style());
+        symbol->setWidth(s->width());
+        symbol->setPen(s->pen());
+        symbol->setBrush(s->brush());
+        c->setSymbol(symbol);
+    }
+    c->setSamples(data);
+    return c;
+}
+
+static QwtPlotItem *snapshotGrid(const QwtPlotGrid *grid)
+{
+    QwtPlotGrid *g = new QwtPlotGrid;
+    g->enableX(grid->xEnabled());
+    g->enableY(grid->yEnabled());
+    g->enableXMin(grid->xMinEnabled());
+    g->enableYMin(grid->yMinEnabled());
+    g->setMajorPen(grid->majorPen());
+    g->setMinorPen(grid->minorPen());
+    g->setXDiv(grid->xScaleDiv());
+    g->setYDiv(grid->yScaleDiv());
+    return g;
+}
+
+// Copy of an item that can be drawn in the render thread, independent
+// of the item and of its data; nullptr if the item is not supported
+static QwtPlotItem *snapshotItem(const QwtPlotItem *item)
+{
+    QwtPlotItem *s = nullptr;
+    switch (item->rtti())
+    {
+    case QwtPlotItem::Rtti_PlotCurve:
+        s = snapshotCurve(static_cast<const QwtPlotCurve *>(item));
+        break;
+    case QwtPlotItem::Rtti_PlotIntervalCurve:
+        s = snapshotBars(static_cast<const QwtPlotIntervalCurve *>(item));
+        break;
+    case QwtPlotItem::Rtti_PlotGrid:
+        s = snapshotGrid(static_cast<const QwtPlotGrid *>(item));
+        break;
+    case QwtPlotItem::Rtti_PlotSpectrogram:
+        if (const ImageSpectrogram *img = dynamic_cast<const ImageSpectrogram *>(item))
+            s = img->snapshot();
+        break;
+    case WaterfallItem::Rtti:
+        s = static_cast<const WaterfallItem *>(item)->snapshot();
+        break;
+    default:
+        break;
+    }
+    if (s)
+        copyItemAttributes(item, s);
+    return s;
+}
+
+// Draw an item as QwtPlot::drawItems() does, return the time taken
+static double drawItem(QPainter *painter,
+                       const QwtPlotItem *item,
+                       const QwtScaleMap maps[QwtPlot::axisCnt],
+                       const QRectF &canvasRect)
+{
+    QElapsedTimer t;
+    t.start();
+    painter->save();
+    painter->setRenderHint(QPainter::Antialiasing,
+                           item->testRenderHint(QwtPlotItem::RenderAntialiased));
+    item->draw(painter, maps[item->xAxis()], maps[item->yAxis()], canvasRect);
+    painter->restore();
+    return msecs(t);
+}
+
+// A frame of the canvas, rendered in the render thread from snapshots
+// of the visible items. Jobs are created and deleted by the GUI thread,
+// so that the adaptor copies never meet the GUI thread concurrently.
+struct RenderJob : public QRunnable
+{
+    QwtBackend *backend;
+    std::vector<std::unique_ptr<QwtPlotItem>> items; // in z order
+    std::vector<int> ids;                            // of the items
+    FrameStats stats;
+    QwtScaleMap maps[QwtPlot::axisCnt];
+    QRectF canvasRect;
+    QSize size;
+    qreal dpr{1.};
+    QImage image;
+    quint64 serial{0};
+
+    explicit RenderJob(QwtBackend *b)
+        : backend(b)
+    {
+        setAutoDelete(false);
+    }
+
+    // as QwtPlot::drawCanvas(), on a transparent image; the canvas
+    // paints its own background
+    void run() override
+    {
+        QElapsedTimer t;
+        t.start();
+        image = QImage(size * dpr, QImage::Format_ARGB32_Premultiplied);
+        image.setDevicePixelRatio(dpr);
+        image.fill(Qt::transparent);
+
+        FrameStats::current = &stats;
+        QPainter painter(&image);
+        for (size_t i = 0; i < items.size(); ++i)
+        {
+            const double ms = drawItem(&painter, items[i].get(), maps, canvasRect);
+            stats.draw += ms;
+            if (stats.itemTimes && ids[i])
+                stats.items[ids[i]] += ms;
+        }
+        painter.end();
+        FrameStats::current = nullptr;
+        stats.total += msecs(t);
+
+        QMetaObject::invokeMethod(backend, "frameReady", Qt::QueuedConnection);
+    }
+};
+
+QwtBackend::~QwtBackend()
+{
+    // the frame in flight refers to the cache counters
+    renderPool_.waitForDone();
+}
+
+void QwtBackend::setThreadedRendering(bool on)
+{
+    if (on == threaded_)
+        return;
+    threaded_ = on;
+    // a frame in flight is discarded by frameReady()
+    queuedJob_.reset();
+    frame_ = QImage();
+    replot();
+}
+
+// Snapshot the visible items and hand the frame to the render thread.
+//
+// Latest wins: while a frame is being rendered, the new one waits in
+// queuedJob_, replacing (dropping) any frame queued before. The frame
+// in flight is always shown, so that a fast data rate cannot starve
+// the display.
+//
+// Returns false, and nothing is queued, if some item cannot be copied;
+// the caller renders the frame on the GUI thread instead.
+bool QwtBackend::submitFrame(const QElapsedTimer &t)
+{
+    std::unique_ptr<RenderJob> job(new RenderJob(this));
+    job->serial = frameSerial_;
+    job->stats.itemTimes = statsInterval_ > 0;
+
+    // autoscale and lay out now, the maps below depend on it
+    const double t0 = msecs(t);
+    updateAxes();
+    const double t1 = msecs(t);
+    job->stats.autoscale = t1 - t0;
+    QCoreApplication::sendPostedEvents(this, QEvent::LayoutRequest);
+    rebinImages();
+    job->stats.layout = msecs(t) - t1;
+
+    for (const QwtPlotItem *item : itemList())
+    {
+        if (!item->isVisible())
+            continue;
+        QwtPlotItem *s = snapshotItem(item);
+        if (!s)
+            return false;
+        job->items.emplace_back(s);
+        job->ids.push_back(itemId(item));
+    }
+    for (int axisId = 0; axisId < QwtPlot::axisCnt; axisId++)
+        job->maps[axisId] = canvasMap(axisId);
+    job->canvasRect = canvas()->contentsRect();
+    job->size = canvas()->size();
+    job->dpr = canvas()->devicePixelRatioF();
+    job->stats.total = msecs(t); // GUI thread part
+
+    if (!renderJob_)
+        startJob(std::move(job));
+    else
+    {
+        if (queuedJob_)
+            ++droppedFrames_;
+        queuedJob_ = std::move(job);
+    }
+    return true;
+}
+
+void QwtBackend::startJob(std::unique_ptr<RenderJob> job)
+{
+    renderJob_ = std::move(job);
+    renderPool_.start(renderJob_.get());
+}
+
+// The render thread finished renderJob_: show it and start the next
+void QwtBackend::frameReady()
+{
+    std::unique_ptr<RenderJob> job = std::move(renderJob_);
+    if (queuedJob_)
+        startJob(std::move(queuedJob_));
+    // older than a frame rendered on the GUI thread meanwhile
+    if (!threaded_ || job->serial < shownSerial_)
+        return;
+
+    shownSerial_ = job->serial;
+    frame_ = job->image;
+    frameSize_ = job->size;
+    FrameStats stats = job->stats;
+    job.reset(); // the snapshots are deleted on the GUI thread
+
+    QElapsedTimer t;
+    t.start();
+    static_cast<QwtPlotCanvas *>(canvas())->replot();
+    stats.blit = msecs(t);
+    stats.total += stats.blit;
+
+    ++frameCount_;
+    frameDone(stats);
+    emit frameRendered();
+}
+
+// Blit the last threaded frame, or draw the items as usual
+void QwtBackend::drawCanvas(QPainter *painter)
+{
+    if (!threaded_ || frame_.isNull())
+    {
+        QwtPlot::drawCanvas(painter);
+        return;
+    }
+    painter->drawImage(QPointF(0., 0.), frame_);
+    // the canvas was resized since: show the frame, render a new one
+    if (frameSize_ != canvas()->size())
+        replot();
+}
+
+// As QwtPlot::drawItems(), timing the items while a frame is measured,
+// each item if the statistics are reported (see setStatsInterval())
+void QwtBackend::drawItems(QPainter *painter,
+                           const QRectF &canvasRect,
+                           const QwtScaleMap maps[QwtPlot::axisCnt]) const
+{
+    FrameStats *stats = FrameStats::current;
+    if (!stats)
+    {
+        QwtPlot::drawItems(painter, canvasRect, maps);
+        return;
+    }
+    if (!stats->itemTimes)
+    {
+        QElapsedTimer t;
+        t.start();
+        QwtPlot::drawItems(painter, canvasRect, maps);
+        stats->draw += msecs(t);
+        return;
+    }
+    for (const QwtPlotItem *item : itemList())
+    {
+        if (!item || !item->isVisible())
+            continue;
+        const double ms = drawItem(painter, item, maps, canvasRect);
+        stats->draw += ms;
+        if (const int id = itemId(item))
+            stats->items[id] += ms;
+    }
+}
+
+/*---- Render statistics -------*/
+
+// Record a rendered frame
+void QwtBackend::frameDone(const FrameStats &stats)
+{
+    const int k = int(statsFrames_++ % QMatPlotWidget::RenderStats::FrameWindow);
+    frameTimes_[k] = stats.total;
+    frameEnds_[k] = statsClock_.nsecsElapsed();
+    lastFrame_ = stats;
+}
+
+QMatPlotWidget::RenderStats QwtBackend::renderStats() const
+{
+    QMatPlotWidget::RenderStats s;
+    s.replotsRequested = replotRequests_;
+    s.replotsPerformed = frameCount_;
+    s.framesDropped = droppedFrames_;
+    s.lastFrameTime = lastFrame_.total;
+    s.autoscaleTime = lastFrame_.autoscale;
+    s.layoutTime = lastFrame_.layout;
+    s.drawTime = lastFrame_.draw;
+    s.blitTime = lastFrame_.blit;
+    s.itemDrawTime = lastFrame_.items;
+    s.pointsSubmitted = lastFrame_.submitted;
+    s.pointsDrawn = lastFrame_.drawn;
+
+    const int window = QMatPlotWidget::RenderStats::FrameWindow;
+    const int n = int(qMin<quint64>(statsFrames_, window));
+    if (n == 0)
+        return s;
+
+    // nearest rank percentiles
+    std::vector<double> times(frameTimes_, frameTimes_ + n);
+    std::sort(times.begin(), times.end());
+    auto percentile = [&](double p) { return times[qBound(0, qCeil(p * n) - 1, n - 1)]; };
+    s.meanFrameTime = std::accumulate(times.begin(), times.end(), 0.) / n;
+    s.p50FrameTime = percentile(0.50);
+    s.p95FrameTime = percentile(0.95);
+    s.p99FrameTime = percentile(0.99);
+    s.maxFrameTime = times.back();
+
+    if (n > 1)
+    {
+        const qint64 last = frameEnds_[(statsFrames_ - 1) % window];
+        const qint64 first = frameEnds_[statsFrames_ > quint64(window) ? statsFrames_ % window : 0];
+        if (last > first)
+            s.fps = (n - 1) * 1e9 / (last - first);
+    }
+    return s;
+}
+
+void QwtBackend::setStatsInterval(int ms)
+{
+    statsInterval_ = qMax(ms, 0);
+    if (statsInterval_)
+        statsTimer_.start(statsInterval_);
+    else
+        statsTimer_.stop();
+}
+
+// Frames per second used for pacing the replots
+double QwtBackend::frameRate() const
+{
+    if (maxFps_ > 0.)
+        return maxFps_;
+    QScreen *s = screen();
+    double hz = s ? s->refreshRate() : 0.;
+    return hz > 0. ? hz : 60.;
+}
+
+// Bring the axes up to date while a replot is pending, so that the
+// scales can be queried right after changing the data or the limits
+void QwtBackend::flushAxes() const
+{
+    if (replotPending_ && !updateDepth_)
+        const_cast<QwtBackend *>(this)->updateAxes();
+}
+
+// Move the samples queued by streaming series into their history
+void QwtBackend::drainStreams()
+{
+    for (QwtPlotItem *item : itemList(QwtPlotItem::Rtti_PlotCurve))
+    {
+        DataHelper *h = dynamic_cast<DataHelper *>(static_cast<QwtPlotCurve *>(item)->data());
+        if (StreamAdaptor *a = h ? dynamic_cast<StreamAdaptor *>(h->d) : nullptr)
+            a->s->drain();
+    }
+}
+
+// Bin the images computed for the visible area (hist2d) over the area
+// of the current scales, once autoscaling and layout are done
+void QwtBackend::rebinImages()
+{
+    const QRectF canvasRect = canvas()->contentsRect();
+    for (QwtPlotItem *item : itemList(QwtPlotItem::Rtti_PlotSpectrogram))
+    {
+        ImageSpectrogram *s = dynamic_cast<ImageSpectrogram *>(item);
+        if (s && s->isVisible())
+            s->rebin(QwtScaleMap::invTransform(canvasMap(item->xAxis()),
+                                               canvasMap(item->yAxis()),
+                                               canvasRect)
+                         .normalized());
+    }
+}
+
+void QwtBackend::dataChanged()
+{
+    for (QwtPlotItem *item : itemList())
+    {
+        switch (item->rtti())
+        {
+        case QwtPlotItem::Rtti_PlotCurve:
+            if (SeriesHelper *h = dynamic_cast<SeriesHelper *>(
+                    static_cast<QwtPlotCurve *>(item)->data()))
+                h->invalidate();
+            break;
+        case QwtPlotItem::Rtti_PlotSpectrogram:
+            if (ImageHelper *h = dynamic_cast<ImageHelper *>(
+                    static_cast<QwtPlotSpectrogram *>(item)->data()))
+                h->changed();
+            break;
+        default:
+            break;
+        }
+    }
 
     replot();
 }
 
 bool QwtBackend::exportToFile(const QString &fname, const QSize &sz)
 {
+    replotNow();
     QwtPlotRenderer plotRenderer;
     QSize szmm(sz);
     if (szmm.isEmpty())
@@ -3,31 +3,97 @@
 
 #include "qmatplotwidget.h"
 #include "qmatplotwidget_p.h"
+#include <QElapsedTimer>
+#include <QHash>
+#include <QImage>
+#include <QThreadPool>
+#include <QTimer>
 #include <qwt_plot.h>
 #include <qwt_plot_grid.h>
 #include <qwt_scale_draw.h>
 #include <qwt_text.h>
 
+#include <atomic>
+#include <memory>
+
 class QwtPlotGrid;
 class QwtPlotGrid;
 class QwtPlotZoomer;
 class QwtPlotPanner;
 class QwtPlotPicker;
 class ScalePicker;
+struct RenderJob;
+
+// Measurements of one frame, times in ms, see QMatPlotWidget::RenderStats
+struct FrameStats
+{
+    double autoscale{0.};
+    double layout{0.};
+    double draw{0.};
+    double blit{0.};
+    double total{0.};
+    QMap<int, double> items; // draw time by item id, if itemTimes
+    bool itemTimes{false};
+    quint64 submitted{0};
+    quint64 drawn{0};
+
+    // the frame being drawn by this thread, if any
+    static thread_local FrameStats *current;
+};
 
 class QwtBackend : public QwtPlot, public QMatPlotWidget::Backend
 {
     Q_OBJECT
 public:
     QwtBackend(QMatPlotWidget *parent);
+    ~QwtBackend() override;
 
     void alignScales();
     virtual bool exportToFile(const QString &fname, const QSize &sz) override;
     virtual void clear() override;
-    virtual void replot() override { QwtPlot::replot(); }
-    virtual void plot(AbstractDataSeriesAdaptor *d, const QMatPlotWidget::LineSpec &l) override;
-    virtual void errorbar(AbstractErrorBarAdaptor *d, const QMatPlotWidget::LineSpec &opt) override;
-    virtual void image(AbstractImageAdaptor *d, bool scale, const QVector<QRgb> &cmap) override;
+    virtual void replot() override;
+    virtual void replotNow() override;
+    virtual void dataChanged() override;
+    virtual double maxFps() const override { return maxFps_; }
+    virtual void setMaxFps(double fps) override { maxFps_ = qMax(fps, 0.); }
+    virtual quint64 mergedReplots() const override { return mergedReplots_; }
+    virtual quint64 frameCount() const override { return frameCount_; }
+    virtual quint64 imageCacheHitCount() const override { return imageCacheHits; }
+    virtual quint64 imageCacheMissCount() const override { return imageCacheMisses; }
+    virtual bool threadedRendering() const override { return threaded_; }
+    virtual void setThreadedRendering(bool on) override;
+    virtual quint64 droppedFrames() const override { return droppedFrames_; }
+    virtual QMatPlotWidget::RenderStats renderStats() const override;
+    virtual int statsInterval() const override { return statsInterval_; }
+    virtual void setStatsInterval(int ms) override;
+    virtual void beginUpdate() override { ++updateDepth_; }
+    virtual void endUpdate() override;
+    virtual bool isUpdating() const override { return updateDepth_ > 0; }
+    virtual void updateLayout() override;
+    virtual int plot(AbstractDataSeriesAdaptor *d, const QMatPlotWidget::LineSpec &l) override;
+    virtual int errorbar(AbstractErrorBarAdaptor *d, const QMatPlotWidget::LineSpec &opt) override;
+    virtual int scatter(AbstractDataSeriesAdaptor *d,
+                        const QMatPlotWidget::LineSpec &opt,
+                        const QVector<QRgb> &cmap) override;
+    virtual int image(AbstractImageAdaptor *d, bool scale, const QVector<QRgb> &cmap) override;
+    virtual int waterfall(int columns,
+                          int depth,
+                          const QPointF &xlim,
+                          const QPointF &clim,
+                          const QVector<QRgb> &cmap) override;
+    virtual bool appendRow(int id, const double *z, int n) override;
+    virtual void setClim(int id, const QPointF &clim) override;
+    virtual bool hasItem(int id) const override { return items_.contains(id); }
+    virtual AbstractDataSeriesAdaptor *seriesAdaptor(int id) const override;
+    virtual AbstractErrorBarAdaptor *errorBarAdaptor(int id) const override;
+    virtual AbstractImageAdaptor *imageAdaptor(int id) const override;
+    virtual void setSeriesAdaptor(int id, AbstractDataSeriesAdaptor *d) override;
+    virtual void setErrorBarAdaptor(int id, AbstractErrorBarAdaptor *d) override;
+    virtual void itemDataChanged(int id) override;
+    virtual void setItemStyle(int id, const QMatPlotWidget::LineSpec &opt) override;
+    virtual void setItemColor(int id, const QColor &clr) override;
+    virtual void setItemVisible(int id, bool on) override;
+    virtual void removeItem(int id) override;
     void setAxisScaling(int axisid, QMatPlotWidget::AxisScale sc);
     virtual QString title() const override { return QwtPlot::title().text(); }
     virtual QString xlabel() const override { return axisTitle(QwtPlot::xBottom).text(); }
@@ -36,12 +102,14 @@ public:
     virtual bool autoScaleY() const override { return axisAutoScale(QwtPlot::yLeft); }
     virtual QPointF xlim() const override
     {
+        flushAxes();
         double lb = axisScaleDiv(QwtPlot::xBottom).lowerBound();
         double ub = axisScaleDiv(QwtPlot::xBottom).upperBound();
         return QPointF(lb, ub);
     }
     virtual QPointF ylim() const override
     {
+        flushAxes();
         double lb = axisScaleDiv(QwtPlot::yLeft).lowerBound();
         double ub = axisScaleDiv(QwtPlot::yLeft).upperBound();
         return QPointF(lb, ub);
@@ -72,6 +140,7 @@ public:
     }
     virtual void setYlim(const QPointF &v) override { setAxisScale(QwtPlot::yLeft, v.x(), v.y()); }
     void setAxisEqual() override;
+    void setColorScale(QMatPlotWidget::AxisScale sc) override;
 
     QMatPlotWidget *mMatPlot_;
     QwtPlotGrid *grid_;
@@ -81,9 +150,85 @@ public:
     ScalePicker *scalepicker;
 
     void doAxisClicked(int axisid, const QPoint &pos) { emit axisClicked(axisid, pos); }
+    void drainStreams();
+    void rebinImages();
+
+    // image render cache statistics, see ImageSpectrogram;
+    // updated by the render thread too
+    std::atomic<quint64> imageCacheHits{0};
+    std::atomic<quint64> imageCacheMisses{0};
+    void flushAxes() const;
+    double frameRate() const;
 
 signals:
     void axisClicked(int axisid, const QPoint &pos);
+    void frameRendered();
+    void renderStatsUpdated(const QMatPlotWidget::RenderStats &stats);
+
+protected:
+    void drawCanvas(QPainter *painter) override;
+    void drawItems(QPainter *painter,
+                   const QRectF &canvasRect,
+                   const QwtScaleMap maps[QwtPlot::axisCnt]) const override;
+
+private slots:
+    void frameReady();
+
+private:
+    // plotted items by id; errorbars have a second item for the bars
+    struct PlotItem
+    {
+        QwtPlotItem *item;
+        QwtPlotItem *bars;
+    };
+    QHash<int, PlotItem> items_;
+    QHash<const QwtPlotItem *, int> itemIds_; // of the items and bars
+    int lastId_{0};
+
+    int addItem(QwtPlotItem *item, QwtPlotItem *bars = nullptr);
+    // id of a plotted item or of its bars, 0 for other items (the grid)
+    int itemId(const QwtPlotItem *item) const { return itemIds_.value(item); }
+
+    // replot scheduling, see replot()
+    QTimer frameTimer_;
+    QElapsedTimer frameClock_;
+    double maxFps_{0.};
+    bool replotPending_{false};
+    quint64 mergedReplots_{0};
+    quint64 frameCount_{0};
+
+    // render statistics, see renderStats()
+    void frameDone(const FrameStats &stats);
+    quint64 replotRequests_{0};
+    FrameStats lastFrame_;
+    double frameTimes_[QMatPlotWidget::RenderStats::FrameWindow];
+    qint64 frameEnds_[QMatPlotWidget::RenderStats::FrameWindow]; // ns on statsClock_
+    quint64 statsFrames_{0};
+    QElapsedTimer statsClock_;
+    QTimer statsTimer_;
+    int statsInterval_{0};
+    quint64 statsReported_{0}; // frameCount_ at the last renderStatsUpdated()
+
+    // log color scale for scaled images
+    bool logColors_{false};
+
+    // update transactions, see beginUpdate()
+    int updateDepth_{0};
+    bool deferredReplot_{false};
+    bool deferredLayout_{false};
+
+    // threaded rendering, see submitFrame()
+    bool submitFrame(const QElapsedTimer &t);
+    void startJob(std::unique_ptr<RenderJob> job);
+    bool threaded_{false};
+    QThreadPool renderPool_;
+    std::unique_ptr<RenderJob> renderJob_; // being rendered
+    std::unique_ptr<RenderJob> queuedJob_; // next, replaced by newer frames
+    QImage frame_;                         // last rendered frame
+    QSize frameSize_;
+    quint64 frameSerial_{0}; // replotNow() calls
+    quint64 shownSerial_{0}; // of the frame on screen
+    quint64 droppedFrames_{0};
 };
 
 #endif // QWTBACKEND_H
@@ -0,0 +1,370 @@
+#ifndef QWTRASTER_H
+#define QWTRASTER_H
+
+#include "qmatplotwidget.h"
+
+#include <QtMath>
+
+#include <qwt_color_map.h>
+#include <qwt_interval.h>
+#include <qwt_raster_data.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+/*
+ * Raster data and color map of the image items, see ImageSpectrogram
+ * and WaterfallItem in qwtbackend.cpp
+ */
+
+// Serial numbers identifying the versions of image data and color maps
+inline quint64 nextSerial()
+{
+    // also called by the render thread, see ImageHelper::init()
+    static std::atomic<quint64> serial{0};
+    return ++serial;
+}
+
+// Raster data reading the image values from the adaptor, without copy.
+//
+// The image is sampled as by QwtMatrixRasterData with nearest neighbour
+// resampling: each value covers a rectangle of the x/y intervals.
+// Values in contiguous memory are read directly, others through the
+// virtual AbstractImageAdaptor::value().
+struct ImageHelper : public QwtRasterData
+{
+    AbstractImageAdaptor *d;
+    bool scale;
+
+    ImageHelper(AbstractImageAdaptor *a, bool scale)
+        : d(a), scale(scale)
+    {
+        init();
+    }
+    ImageHelper(const ImageHelper &other)
+        : d(other.d), scale(other.scale)
+    {
+        init();
+    }
+    // snapshot of other for the render thread, reading from a, a copy of
+    // its adaptor; keeps the version, so that the render cache is shared
+    ImageHelper(const ImageHelper &other, AbstractImageAdaptor *a)
+        : d(a), scale(other.scale)
+    {
+        version = other.version;
+        positive_ = other.positive_;
+        positiveVersion_ = other.positiveVersion_;
+        std::copy(other.intervals_, other.intervals_ + 3, intervals_);
+#if QWT_VERSION < 0x060200
+        for (int i = Qt::XAxis; i <= Qt::ZAxis; ++i)
+            setInterval(Qt::Axis(i), intervals_[i]);
+#endif
+        cols_ = other.cols_;
+        rows_ = other.rows_;
+        dx_ = other.dx_;
+        dy_ = other.dy_;
+        z_ = d->valueData();
+    }
+    virtual ~ImageHelper() { delete d; }
+    // the data were modified in place
+    void changed()
+    {
+        d->invalidate();
+        init();
+    }
+    // update the cached geometry and z range after a data change
+    void init()
+    {
+        version = nextSerial();
+
+        QPointF v = d->xlim();
+        intervals_[Qt::XAxis] = QwtInterval(v.x(), v.y());
+        v = d->ylim();
+        intervals_[Qt::YAxis] = QwtInterval(v.x(), v.y());
+        v = d->zlim();
+        intervals_[Qt::ZAxis] = QwtInterval(v.x(), v.y());
+#if QWT_VERSION < 0x060200
+        for (int i = Qt::XAxis; i <= Qt::ZAxis; ++i)
+            setInterval(Qt::Axis(i), intervals_[i]);
+#endif
+
+        cols_ = d->columns();
+        rows_ = d->rows();
+        dx_ = cols_ ? intervals_[Qt::XAxis].width() / cols_ : 0.;
+        dy_ = rows_ ? intervals_[Qt::YAxis].width() / rows_ : 0.;
+        z_ = d->valueData();
+    }
+
+#if QWT_VERSION >= 0x060200
+    QwtInterval interval(Qt::Axis axis) const override { return intervals_[axis]; }
+#endif
+
+    QRectF pixelHint(const QRectF &) const override
+    {
+        return QRectF(intervals_[Qt::XAxis].minValue(), intervals_[Qt::YAxis].minValue(), dx_, dy_);
+    }
+
+    double value(double x, double y) const override
+    {
+        const int row = this->row(y);
+        const int col = column(x);
+        if (row < 0 || col < 0)
+            return qQNaN();
+        const int k = row * cols_ + col;
+        return z_ ? z_[k] : d->value(k);
+    }
+
+    // data column/row at x/y, -1 if outside the image;
+    // the maximum of the intervals falls in the last column/row
+    int column(double x) const
+    {
+        const QwtInterval &xi = intervals_[Qt::XAxis];
+        if (!xi.contains(x) || !cols_)
+            return -1;
+        return std::min(int((x - xi.minValue()) / dx_), cols_ - 1);
+    }
+    int row(double y) const
+    {
+        const QwtInterval &yi = intervals_[Qt::YAxis];
+        if (!yi.contains(y) || !rows_)
+            return -1;
+        return std::min(int((y - yi.minValue()) / dy_), rows_ - 1);
+    }
+    // changes with every init(), i.e. with every data change
+    quint64 version{0};
+
+    // smallest positive value, +inf if there is none: the lower bound of
+    // the colors in log scale when the values reach 0 (see
+    // ColorMapHelper::colorRange()). Computed on first use after a data
+    // change, not thread safe until then.
+    double positiveMin() const
+    {
+        if (positiveVersion_ == version)
+            return positive_;
+        double m = std::numeric_limits<double>::infinity();
+        const int n = cols_ * rows_;
+        for (int k = 0; k < n; ++k)
+        {
+            const double v = z_ ? z_[k] : d->value(k);
+            if (v > 0. && v < m)
+                m = v;
+        }
+        positive_ = m;
+        positiveVersion_ = version;
+        return m;
+    }
+
+    // out[i] = value at (cols[i], row(y)) for i in [0, n)
+    void scanline(double y, const int *cols, int n, double *out) const
+    {
+        const int r = row(y);
+        if (r < 0)
+        {
+            std::fill(out, out + n, qQNaN());
+            return;
+        }
+        const int base = r * cols_;
+        for (int i = 0; i < n; ++i)
+        {
+            const int c = cols[i];
+            out[i] = c < 0 ? qQNaN() : z_ ? z_[base + c] : d->value(base + c);
+        }
+    }
+
+private:
+    QwtInterval intervals_[3];
+    const double *z_{nullptr};
+    int cols_{0}, rows_{0};
+    mutable double positive_{0.};
+    mutable quint64 positiveVersion_{0};
+    double dx_{0.}, dy_{0.};
+};
+
+// log2(v) for normal v > 0, to about 2e-4: the exponent is read from the
+// bits of v and the log2 of the mantissa from a table indexed by its
+// 12 leading bits
+struct FastLog2
+{
+    static const int Bits = 12;
+    float table[1 << Bits];
+
+    FastLog2()
+    {
+        for (int i = 0; i < (1 << Bits); ++i)
+            table[i] = float(std::log2(1. + (i + 0.5) / (1 << Bits)));
+    }
+    double operator()(double v) const
+    {
+        quint64 b;
+        std::memcpy(&b, &v, sizeof(b));
+        const int e = int((b >> 52) & 0x7ff) - 1023;
+        return e + table[(b >> (52 - Bits)) & ((1 << Bits) - 1)];
+    }
+    // the table, built once for the whole library
+    static const FastLog2 &instance()
+    {
+        static const FastLog2 log2;
+        return log2;
+    }
+};
+
+// Color map with a lookup table.
+//
+// Values are converted to table indexes with one multiply-add, after a
+// fast log2 in log color scale. Whole scanlines are colorized by
+// colorize(): the index pass has no branches or calls, so that the
+// compiler can vectorize it, and the lookup pass is a plain gather.
+// NaN values, and values <= 0 in log scale, are transparent.
+//
+// The indexes are computed in double precision rather than as 16.16
+// fixed point: the values are doubles, so a fixed-point index needs the
+// same multiply-add and conversion plus a saturation to stay in range.
+// The bench measures both (ColorMapHelper/linear/colorize and
+// colorizeQ16): on x86-64 with GCC 12, 1M values, the fixed-point pass
+// took 4.6-5.3 ns/px against 3.9-4.6 at -O2, and 3.1 against 1.45 with
+// -O3 -mavx2.
+class ColorMapHelper : public QwtColorMap
+{
+    QVector<QRgb> map;
+    QVector<QRgb> lut_; // map + a transparent entry for invalid values
+    bool scale_;
+    bool log_;
+    quint64 serial_;
+
+    // value -> fractional table index: v * gain + offset (log2(v) if log_);
+    // in log scale, a lower bound <= 0 left by colorRange() means that no
+    // value of the data is in range, and the colors span one octave
+    bool transform(const QwtInterval &interval, double &gain, double &offset) const
+    {
+        gain = 1.;
+        offset = 0.;
+        if (!scale_)
+            return true;
+
+        double lo = interval.minValue(), hi = interval.maxValue();
+        if (log_)
+        {
+            if (!(hi > 0.))
+                return false;
+            lo = lo > 0. ? std::log2(lo) : std::log2(hi) - 1.;
+            hi = std::log2(hi);
+        }
+        const double width = hi - lo;
+        if (!(width > 0.))
+            return false;
+        gain = map.size() / width;
+        offset = -lo * gain;
+        return true;
+    }
+
+public:
+    explicit ColorMapHelper(const QVector<QRgb> &m, bool scale = true, bool log = false)
+        : QwtColorMap(QwtColorMap::RGB)
+        , map(m)
+        , lut_(m)
+        , scale_(scale)
+        , log_(log && scale)
+        , serial_(nextSerial())
+    {
+        lut_ << 0u;
+    }
+    // copy for the render thread, with the same serial
+    ColorMapHelper(const ColorMapHelper &other)
+        : QwtColorMap(QwtColorMap::RGB)
+        , map(other.map)
+        , lut_(other.lut_)
+        , scale_(other.scale_)
+        , log_(other.log_)
+        , serial_(other.serial_)
+    {
+    }
+
+    const QVector<QRgb> &colors() const { return map; }
+    bool scaled() const { return scale_; }
+    bool logScale() const { return log_; }
+
+    // the interval mapped to the colors: in log scale, a lower bound <= 0
+    // is replaced by positive, the smallest positive value of the data,
+    // as MATLAB does for CLim
+    QwtInterval colorRange(const QwtInterval &clim, double positive) const
+    {
+        if (!log_ || clim.minValue() > 0. || !(positive > 0. && positive < clim.maxValue()))
+            return clim;
+        return QwtInterval(positive, clim.maxValue());
+    }
+    // unique to each color map object
+    quint64 serial() const { return serial_; }
+
+    // out[i] = color of v[i], for i in [0, n)
+    void colorize(const QwtInterval &interval, const double *v, int n, QRgb *out) const
+    {
+        const int invalid = map.size();
+        double gain, offset;
+        if (!transform(interval, gain, offset) || map.isEmpty())
+        {
+            std::fill(out, out + n, 0u);
+            return;
+        }
+
+        const double top = invalid - 1;
+        const QRgb *lut = lut_.constData();
+        const FastLog2 &fastLog2 = FastLog2::instance();
+        int idx[256];
+        for (int i0 = 0; i0 < n; i0 += 256)
+        {
+            const int m = std::min(256, n - i0);
+            const double *vv = v + i0;
+            if (log_)
+            {
+                for (int i = 0; i < m; ++i)
+                {
+                    const double x = vv[i];
+                    const double t = fastLog2(std::abs(x)) * gain + offset;
+                    idx[i] = x > 0. ? int(std::max(0., std::min(t, top))) : invalid;
+                }
+            }
+            else
+            {
+                for (int i = 0; i < m; ++i)
+                {
+                    // a NaN t fails both compares and yields invalid
+                    const double t = vv[i] * gain + offset;
+                    const double c = std::max(0., std::min(t, top));
+                    idx[i] = t == t ? int(c) : invalid;
+                }
+            }
+            for (int i = 0; i < m; ++i)
+                out[i0 + i] = lut[idx[i]];
+        }
+    }
+
+    QRgb rgb(const QwtInterval &interval, double value) const override
+    {
+        QRgb c;
+        colorize(interval, &value, 1, &c);
+        return c;
+    }
+
+#if QWT_VERSION >= 0x060200
+    uint colorIndex(int numColors, const QwtInterval &interval, double value) const override
+#else
+    unsigned char colorIndex(const QwtInterval &interval, double value) const override
+#endif
+    {
+        // as colorize(), invalid values get the first color
+        double gain, offset;
+        if (map.isEmpty() || !transform(interval, gain, offset))
+            return 0u;
+        if (log_)
+            value = value > 0. ? FastLog2::instance()(value) : qQNaN();
+        const double t = value * gain + offset;
+        if (!(t == t))
+            return 0u;
+        return int(std::max(0., std::min(t, map.size() - 1.)));
+    }
+};
+
+#endif // QWTRASTER_H
@@ -0,0 +1,199 @@
+#include "qmatplotwidget.h"
+#include "qmatplotwidget_p.h"
+
+#include <algorithm>
+
+// smallest power of 2 >= n
+static quint64 ceilPow2(quint64 n)
+{
+    quint64 p = 1;
+    while (p < n)
+        p <<= 1;
+    return p;
+}
+
+StreamingSeries::StreamingSeries(int capacity)
+    : notifier_(new StreamNotifier)
+    , hx_(std::max(capacity, 1))
+    , hy_(std::max(capacity, 1))
+    , capacity_(std::max(capacity, 1))
+{
+    // room for a few frames worth of samples at high rates
+    const quint64 qsize = ceilPow2(std::max<quint64>(2 * quint64(capacity_), 65536));
+    qx_.resize(qsize);
+    qy_.resize(qsize);
+    mask_ = qsize - 1;
+}
+
+StreamingSeries::~StreamingSeries()
+{
+    // the last owner may be a producer thread
+    notifier_->deleteLater();
+}
+
+int StreamingSeries::append(const double *x, const double *y, int n)
+{
+    if (n <= 0 || !attached.load(std::memory_order_relaxed))
+        return 0;
+
+    const quint64 h = head_.load(std::memory_order_relaxed);
+    const quint64 t = tail_.load(std::memory_order_acquire);
+    const int m = int(std::min<quint64>(quint64(n), qx_.size() - (h - t)));
+
+    for (int k = 0; k < m; ++k)
+    {
+        const quint64 j = (h + k) & mask_;
+        qx_[j] = x[k];
+        qy_[j] = y[k];
+    }
+    head_.store(h + m, std::memory_order_release);
+
+    if (m < n)
+        dropped_.fetch_add(quint64(n - m), std::memory_order_relaxed);
+
+    // one notification until the GUI thread drains the queue
+    if (m && !pending_.exchange(true))
+        emit notifier_->updated();
+
+    return m;
+}
+
+int StreamingSeries::drain()
+{
+    // re-arm the notification before looking at the queue, so that
+    // samples published after the load below trigger a new one
+    pending_.store(false);
+
+    const quint64 t = tail_.load(std::memory_order_relaxed);
+    const quint64 h = head_.load(std::memory_order_acquire);
+    if (h == t)
+        return 0;
+
+    // only the last capacity_ samples survive in the history
+    const quint64 skip = h - t > quint64(capacity_) ? h - t - capacity_ : 0;
+    const int first = first_;
+    const int overwritten = std::max(int(h - t - skip) - (capacity_ - n_), 0);
+    for (quint64 j = t + skip; j < h; ++j)
+        push(qx_[j & mask_], qy_[j & mask_]);
+
+    // the overwritten samples are rescanned by the extents cache, the
+    // others are seen as appended
+    if (first + overwritten <= capacity_)
+    {
+        if (overwritten > 0)
+            extents_.changed(first, first + overwritten);
+    }
+    else
+    {
+        extents_.changed(first, capacity_);
+        extents_.changed(0, first + overwritten - capacity_);
+    }
+
+    tail_.store(h, std::memory_order_release);
+    return int(h - t);
+}
+
+void StreamingSeries::push(double x, double y)
+{
+    // the new sample follows the last one
+    if (n_ > 0 && capacity_ > 1 && !(sample(n_ - 1).x() <= x))
+        ++descents_;
+    if (qIsNaN(x) || qIsNaN(y))
+        ++nans_;
+
+    int k;
+    if (n_ < capacity_)
+    {
+        // still growing: the extents cache sees an append
+        k = n_++;
+    }
+    else
+    {
+        // the oldest sample no longer precedes the next one
+        if (capacity_ > 1 && !(sample(0).x() <= sample(1).x()))
+            --descents_;
+        if (qIsNaN(hx_[first_]) || qIsNaN(hy_[first_]))
+            --nans_;
+        // overwrite the oldest sample
+        k = first_++;
+        if (first_ == capacity_)
+            first_ = 0;
+    }
+    hx_[k] = x;
+    hy_[k] = y;
+}
+
+bool StreamingSeries::view(SeriesView &v) const
+{
+    // contiguous in index order only before the history wraps around
+    if (first_ != 0)
+        return false;
+    v.x = hx_.data();
+    v.y = hy_.data();
+    v.xstride = v.ystride = 1;
+    v.size = n_;
+    return true;
+}
+
+void StreamingSeries::views(SeriesView &a, SeriesView &b) const
+{
+    // [first_, n_) then [0, first_); first_ is 0 until the ring is full
+    a = SeriesView();
+    a.x = hx_.data() + first_;
+    a.y = hy_.data() + first_;
+    a.size = n_ - first_;
+    b = SeriesView();
+    b.x = hx_.data();
+    b.y = hy_.data();
+    b.size = first_;
+}
+
+void StreamingSeries::copy(double *x, double *y) const
+{
+    std::copy(hx_.begin() + first_, hx_.begin() + n_, x);
+    std::copy(hx_.begin(), hx_.begin() + first_, x + n_ - first_);
+    std::copy(hy_.begin() + first_, hy_.begin() + n_, y);
+    std::copy(hy_.begin(), hy_.begin() + first_, y + n_ - first_);
+}
+
+bool StreamingSeries::segments(QVector<SeriesSegment> &runs) const
+{
+    if (nans_ > 0)
+        return false;
+    runs.clear();
+    if (n_ > 0)
+        runs += SeriesSegment{0, n_};
+    return true;
+}
+
+QRectF StreamingSeries::boundingRect()
+{
+    // the extents do not depend on the order of the samples, so they
+    // are computed over the physical history
+    return extents_
+        .extents(n_,
+                 [this](int i, int j) {
+                     SeriesExtents e;
+                     minMaxOf(hx_, i, j, e.x1, e.x2, 0);
+                     minMaxOf(hy_, i, j, e.y1, e.y2, 0);
+                     return e;
+                 })
+        .rect();
+}
+
+/*---- StreamWriter -------*/
+
+bool StreamWriter::isValid() const
+{
+    return d_ && d_->attached.load(std::memory_order_relaxed);
+}
+
+int StreamWriter::append(const double *x, const double *y, int n)
+{
+    return d_ ? d_->append(x, y, n) : 0;
+}
+
+quint64 StreamWriter::dropped() const
+{
+    return d_ ? d_->dropped() : 0;
+}
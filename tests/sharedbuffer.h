@@ -0,0 +1,36 @@
+#ifndef SHAREDBUFFER_H
+#define SHAREDBUFFER_H
+
+#include <QMatPlotWidget>
+
+#include <initializer_list>
+#include <memory>
+#include <vector>
+
+// Container of shared, growing data, reporting the changes made in
+// place as user containers do, see DataChangeNotifier
+struct SharedBuffer
+{
+    struct Data
+    {
+        std::vector<double> v;
+        DataChangeNotifier notifier;
+    };
+    std::shared_ptr<Data> d{std::make_shared<Data>()};
+
+    SharedBuffer() {}
+    SharedBuffer(std::initializer_list<double> v) { d->v = v; }
+
+    int size() const { return int(d->v.size()); }
+    double operator[](int i) const { return d->v[i]; }
+    const double *data() const { return d->v.data(); }
+    DataChangeNotifier *changeNotifier() const { return &d->notifier; }
+
+    void set(int i, double y)
+    {
+        d->v[i] = y;
+        d->notifier.notifyChanged(i, i + 1);
+    }
+};
+
+#endif // SHAREDBUFFER_H
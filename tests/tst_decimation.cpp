@@ -0,0 +1,112 @@
+#include <QMatPlotWidget>
+
+#include <QtTest>
+
+#include <qwt_plot.h>
+
+// M4 decimation of dense line series: the first, minimum, maximum and
+// last sample of each pixel column are drawn, see m4Decimate()
+class TestDecimation : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void keepsExtremes();
+    void boundedByWidth();
+    void sparseSeriesNotDecimated();
+};
+
+// show w and render a frame, return its plot
+static QwtPlot *render(QMatPlotWidget &w)
+{
+    w.resize(400, 300);
+    w.show();
+    if (!QTest::qWaitForWindowExposed(&w))
+        return nullptr;
+    w.replot();
+    w.replotNow();
+    return w.findChild<QwtPlot *>();
+}
+
+// true if the canvas has a reddish pixel, of a red line blended into
+// the background, within 2 pixels of (x, y)
+static bool redNear(QwtPlot *plot, double x, double y)
+{
+    const QImage image = plot->canvas()->grab().toImage();
+    const int px = qRound(plot->transform(QwtPlot::xBottom, x));
+    const int py = qRound(plot->transform(QwtPlot::yLeft, y));
+    for (int j = py - 2; j <= py + 2; ++j)
+    {
+        for (int i = px - 2; i <= px + 2; ++i)
+        {
+            if (!image.valid(i, j))
+                continue;
+            const QColor c = image.pixelColor(i, j);
+            if (c.red() - c.green() > 60 && c.red() - c.blue() > 60)
+                return true;
+        }
+    }
+    return false;
+}
+
+void TestDecimation::keepsExtremes()
+{
+    // single sample spikes, far more samples than pixels
+    const int n = 1 << 20;
+    QVector<double> y(n, 0.);
+    y[n / 3] = 1.;
+    y[2 * n / 3] = -1.;
+
+    QMatPlotWidget w;
+    w.plot(y, "-", Qt::red);
+    w.setXlim(QPointF(0, n - 1));
+    w.setYlim(QPointF(-1.5, 1.5));
+    QwtPlot *plot = render(w);
+    QVERIFY(plot);
+
+    QVERIFY(redNear(plot, n / 3, 1.));
+    QVERIFY(redNear(plot, 2 * n / 3, -1.));
+    QVERIFY(redNear(plot, 0, 0.));
+    QVERIFY(redNear(plot, n - 1, 0.));
+}
+
+void TestDecimation::boundedByWidth()
+{
+    const int n = 1 << 20;
+    QVector<double> y(n);
+    for (int i = 0; i < n; ++i)
+        y[i] = std::sin(i * 0.01) + (i % 7) * 0.1;
+
+    QMatPlotWidget w;
+    w.plot(y);
+    w.setXlim(QPointF(0, n - 1));
+    QwtPlot *plot = render(w);
+    QVERIFY(plot);
+
+    // at most 4 points per pixel column
+    const QMatPlotWidget::RenderStats stats = w.renderStats();
+    QCOMPARE(stats.pointsSubmitted, quint64(n));
+    QVERIFY(stats.pointsDrawn > 0);
+    QVERIFY(stats.pointsDrawn <= quint64(4 * (plot->canvas()->width() + 2)));
+}
+
+void TestDecimation::sparseSeriesNotDecimated()
+{
+    const int n = 100;
+    QVector<double> y(n);
+    for (int i = 0; i < n; ++i)
+        y[i] = i % 2;
+
+    QMatPlotWidget w;
+    w.plot(y);
+    w.setXlim(QPointF(0, n - 1));
+    w.setYlim(QPointF(-1, 2));
+    QVERIFY(render(w));
+
+    const QMatPlotWidget::RenderStats stats = w.renderStats();
+    QCOMPARE(stats.pointsSubmitted, quint64(n));
+    QCOMPARE(stats.pointsDrawn, quint64(n));
+}
+
+QTEST_MAIN(TestDecimation)
+#include "tst_decimation.moc"
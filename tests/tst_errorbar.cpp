@@ -0,0 +1,127 @@
+#include "sharedbuffer.h"
+
+#include <QtTest>
+
+#include <memory>
+
+// Error bar intervals, computed on demand from the errors as given
+class TestErrorBar : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void scalarError();
+    void symmetricErrors();
+    void asymmetricErrors();
+    void followsChanges();
+    void replacesErrors();
+    void scaledIntervals();
+    void copiesErrors();
+};
+
+void TestErrorBar::scalarError()
+{
+    const double nan = qQNaN();
+    ErrorBarAdaptor<QVector<double>> a(QVector<double>{1., 2., nan, 4.}, 0.5);
+    QCOMPARE(a.size(), 4);
+    QCOMPARE(a.interval(0), QPointF(0.5, 1.5));
+    QCOMPARE(a.interval(3), QPointF(3.5, 4.5));
+    QCOMPARE(a.boundingRect(), QRectF(0, 1, 3, 3));
+    QCOMPARE(a.errorBoundingRect(), QRectF(0, 0.5, 3, 4));
+}
+
+void TestErrorBar::symmetricErrors()
+{
+    // the widest bar is not at the extremes of y
+    QVector<double> x{0., 1., 2., 3.}, y{0., 10., 0., 0.}, e{5., 0., 20., 0.};
+    ErrorBarAdaptor<QVector<double>> a(x, y, e);
+    QCOMPARE(a.interval(0), QPointF(-5, 5));
+    QCOMPARE(a.interval(1), QPointF(10, 10));
+    QCOMPARE(a.interval(2), QPointF(-20, 20));
+    QCOMPARE(a.boundingRect(), QRectF(0, 0, 3, 10));
+    QCOMPARE(a.errorBoundingRect(), QRectF(0, -20, 3, 40));
+}
+
+void TestErrorBar::asymmetricErrors()
+{
+    QVector<double> x{0., 1., 2.}, y{1., 2., 3.}, em{1., 0., 0.5}, ep{0., 3., 0.5};
+    ErrorBarAdaptor<QVector<double>> a(x, y, em, ep);
+    QCOMPARE(a.interval(0), QPointF(0, 1));
+    QCOMPARE(a.interval(1), QPointF(2, 5));
+    QCOMPARE(a.interval(2), QPointF(2.5, 3.5));
+    QCOMPARE(a.errorBoundingRect(), QRectF(0, 0, 2, 5));
+}
+
+void TestErrorBar::followsChanges()
+{
+    SharedBuffer x{0., 1., 2.}, y{1., 1., 1.}, e{0.1, 0.1, 0.1};
+    ErrorBarAdaptor<SharedBuffer> a(x, y, e);
+    QCOMPARE(a.errorBoundingRect(), QRectF(0, 0.9, 2, 0.2));
+
+    // nothing is stored per sample: the intervals follow the data
+    e.set(1, 2.);
+    QCOMPARE(a.interval(1), QPointF(-1, 3));
+    QCOMPARE(a.errorBoundingRect(), QRectF(0, -1, 2, 4));
+    y.set(2, 5.);
+    QCOMPARE(a.interval(2), QPointF(4.9, 5.1));
+    QCOMPARE(a.boundingRect(), QRectF(0, 1, 2, 4));
+    QCOMPARE(a.errorBoundingRect(), QRectF(0, -1, 2, 6.1));
+
+    // appended samples need no notification
+    x.d->v.push_back(3.);
+    y.d->v.push_back(-4.);
+    e.d->v.push_back(1.);
+    QCOMPARE(a.size(), 4);
+    QCOMPARE(a.interval(3), QPointF(-5, -3));
+    QCOMPARE(a.errorBoundingRect(), QRectF(0, -5, 3, 10.1));
+}
+
+void TestErrorBar::replacesErrors()
+{
+    QVector<double> y{1., 2.};
+    ErrorBarAdaptor<QVector<double>> a(y, QVector<double>{1., 1.});
+    QCOMPARE(a.errorBoundingRect(), QRectF(0, 0, 1, 3));
+    a.setYData(y, 2.);
+    QCOMPARE(a.interval(0), QPointF(-1, 3));
+    QCOMPARE(a.errorBoundingRect(), QRectF(0, -1, 1, 5));
+    a.setYData(QVector<double>{1., 6.}, QVector<double>{0., 1.});
+    QCOMPARE(a.interval(1), QPointF(5, 7));
+    QCOMPARE(a.errorBoundingRect(), QRectF(0, 1, 1, 6));
+}
+
+void TestErrorBar::scaledIntervals()
+{
+    ErrorBarAdaptor<QVector<double>> a(QVector<double>{1., 2.}, 0.5);
+    a.yScale.scale = 2.;
+    a.yScale.offset = 1.;
+    QCOMPARE(a.sample(1), QPointF(1, 5));
+    QCOMPARE(a.interval(1), QPointF(4, 6));
+    QCOMPARE(a.errorBoundingRect(), QRectF(0, 2, 1, 4));
+
+    // a negative scale flips the bars
+    a.yScale.scale = -1.;
+    a.yScale.offset = 0.;
+    QCOMPARE(a.interval(0), QPointF(-1.5, -0.5));
+    QCOMPARE(a.errorBoundingRect(), QRectF(0, -2.5, 1, 2));
+}
+
+void TestErrorBar::copiesErrors()
+{
+    ErrorBarAdaptor<QVector<double>> a(QVector<double>{0., 1.},
+                                       QVector<double>{1., 2.},
+                                       QVector<double>{0.5, 0.},
+                                       QVector<double>{0., 0.5});
+    std::unique_ptr<AbstractErrorBarAdaptor> c(a.clone());
+    QVERIFY(c);
+    QCOMPARE(c->interval(0), a.interval(0));
+    QCOMPARE(c->interval(1), a.interval(1));
+    QCOMPARE(c->errorBoundingRect(), a.errorBoundingRect());
+
+    // views of the caller's memory are not copied
+    const double y[] = {1., 2.};
+    ErrorBarAdaptor<DataView<double>> v(DataView<double>(y, 2), 1.);
+    QVERIFY(!v.clone());
+}
+
+QTEST_MAIN(TestErrorBar)
+#include "tst_errorbar.moc"
@@ -0,0 +1,246 @@
+#include "adaptors_p.h"
+#include "sharedbuffer.h"
+
+#include <QtTest>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+// Cached extents of series: blocks rescanned after changed(), appended
+// samples folded in, full rescans after invalidate() or shrinking
+class TestExtents : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void scansOnce();
+    void rescansChangedBlocks();
+    void foldsAppended();
+    void rescansAfterShrinking();
+    void rescansAfterInvalidate();
+    void adaptorFollowsNotifications();
+    void adaptorFollowsAppends();
+    void copiesKeepTheSource();
+
+private:
+    int threshold_;
+};
+
+namespace {
+
+const int BlockSize = ExtentsCache::BlockSize;
+
+// extents of y over the sample index, counting the samples scanned
+struct Scanner
+{
+    std::vector<double> y;
+    std::atomic<int> scanned{0};
+
+    const SeriesExtents &extents(ExtentsCache &cache)
+    {
+        scanned = 0;
+        return cache.extents(int(y.size()), [this](int from, int to) {
+            SeriesExtents e;
+            for (int i = from; i < to; ++i)
+                e.add(i, y[i]);
+            scanned += to - from;
+            return e;
+        });
+    }
+};
+
+} // namespace
+
+void TestExtents::initTestCase()
+{
+    // the block bookkeeping does not depend on the tasks
+    threshold_ = QMatPlotWidget::parallelThreshold();
+    QMatPlotWidget::setParallelThreshold(0);
+}
+
+void TestExtents::cleanupTestCase()
+{
+    QMatPlotWidget::setParallelThreshold(threshold_);
+}
+
+void TestExtents::scansOnce()
+{
+    Scanner s;
+    s.y.assign(3 * BlockSize + 17, 1.);
+    ExtentsCache cache;
+    QCOMPARE(s.extents(cache).rect(), QRectF(0, 1, 3 * BlockSize + 16, 0));
+    QCOMPARE(s.scanned.load(), 3 * BlockSize + 17);
+    s.extents(cache);
+    QCOMPARE(s.scanned.load(), 0);
+}
+
+void TestExtents::rescansChangedBlocks()
+{
+    Scanner s;
+    s.y.assign(4 * BlockSize, 0.);
+    ExtentsCache cache;
+    s.extents(cache);
+
+    // only the block of the changed sample
+    s.y[BlockSize + 5] = 10.;
+    cache.changed(BlockSize + 5, BlockSize + 6);
+    QCOMPARE(s.extents(cache).y2, 10.);
+    QCOMPARE(s.scanned.load(), BlockSize);
+
+    // a lower value is not merged but rescanned
+    s.y[BlockSize + 5] = 0.;
+    cache.changed(BlockSize + 5, BlockSize + 6);
+    QCOMPARE(s.extents(cache).y2, 0.);
+    QCOMPARE(s.scanned.load(), BlockSize);
+
+    // ranges reported before a query are merged, across block bounds
+    s.y[BlockSize - 1] = -1.;
+    s.y[2 * BlockSize] = 2.;
+    cache.changed(BlockSize - 1, BlockSize);
+    cache.changed(2 * BlockSize, 2 * BlockSize + 1);
+    const SeriesExtents e = s.extents(cache);
+    QCOMPARE(e.y1, -1.);
+    QCOMPARE(e.y2, 2.);
+    QCOMPARE(s.scanned.load(), 3 * BlockSize);
+
+    // without a notification the cache is not updated
+    s.y[0] = 100.;
+    QCOMPARE(s.extents(cache).y2, 2.);
+    QCOMPARE(s.scanned.load(), 0);
+}
+
+void TestExtents::foldsAppended()
+{
+    Scanner s;
+    s.y.assign(BlockSize - 3, 0.);
+    ExtentsCache cache;
+    s.extents(cache);
+
+    // the new samples fill the last block and start the next one
+    s.y.resize(BlockSize + 7, 5.);
+    SeriesExtents e = s.extents(cache);
+    QCOMPARE(s.scanned.load(), 10);
+    QCOMPARE(e.x2, double(BlockSize + 6));
+    QCOMPARE(e.y2, 5.);
+
+    // a change rescans all the blocks it touches
+    s.y[BlockSize - 1] = 0.;
+    s.y[BlockSize - 2] = 0.;
+    s.y[BlockSize - 3] = 0.;
+    for (int i = BlockSize; i < BlockSize + 7; ++i)
+        s.y[i] = 0.;
+    cache.changed(BlockSize - 3, BlockSize + 7);
+    e = s.extents(cache);
+    QCOMPARE(s.scanned.load(), BlockSize + 7);
+    QCOMPARE(e.y2, 0.);
+
+    // a change together with appends
+    s.y[0] = -3.;
+    s.y.resize(BlockSize + 10, 1.);
+    cache.changed(0, 1);
+    e = s.extents(cache);
+    QCOMPARE(s.scanned.load(), BlockSize + 3);
+    QCOMPARE(e.y1, -3.);
+    QCOMPARE(e.y2, 1.);
+    QCOMPARE(e.x2, double(BlockSize + 9));
+}
+
+void TestExtents::rescansAfterShrinking()
+{
+    Scanner s;
+    s.y.assign(2 * BlockSize, 0.);
+    s.y.back() = 9.;
+    ExtentsCache cache;
+    s.extents(cache);
+
+    s.y.resize(BlockSize);
+    const SeriesExtents e = s.extents(cache);
+    QCOMPARE(s.scanned.load(), BlockSize);
+    QCOMPARE(e.y2, 0.);
+    QCOMPARE(e.x2, double(BlockSize - 1));
+}
+
+void TestExtents::rescansAfterInvalidate()
+{
+    Scanner s;
+    s.y.assign(2 * BlockSize, 0.);
+    ExtentsCache cache;
+    s.extents(cache);
+
+    s.y[3] = 4.;
+    cache.invalidate();
+    QCOMPARE(s.extents(cache).y2, 4.);
+    QCOMPARE(s.scanned.load(), 2 * BlockSize);
+
+    // an empty series has empty extents
+    s.y.clear();
+    cache.invalidate();
+    QVERIFY(s.extents(cache).isEmpty());
+    QVERIFY(s.extents(cache).rect().isNull());
+}
+
+void TestExtents::adaptorFollowsNotifications()
+{
+    SharedBuffer y;
+    y.d->v.assign(3 * BlockSize, 1.);
+    DataSeriesAdaptor<SharedBuffer> a(y);
+    QCOMPARE(a.boundingRect(), QRectF(0, 1, 3 * BlockSize - 1, 0));
+
+    y.set(BlockSize, 8.);
+    QCOMPARE(a.boundingRect().bottom(), 8.);
+    y.set(BlockSize, 1.);
+    QCOMPARE(a.boundingRect().bottom(), 1.);
+
+    y.d->v[0] = -2.;
+    y.d->notifier.notifyInvalidated();
+    QCOMPARE(a.boundingRect().top(), -2.);
+}
+
+void TestExtents::adaptorFollowsAppends()
+{
+    SharedBuffer x, y;
+    for (int i = 0; i < BlockSize; ++i)
+    {
+        x.d->v.push_back(i);
+        y.d->v.push_back(0.);
+    }
+    DataSeriesAdaptor<SharedBuffer> a(x, y);
+    QCOMPARE(a.boundingRect(), QRectF(0, 0, BlockSize - 1, 0));
+    QVERIFY(a.sortedX());
+
+    // appended samples need no notification
+    x.d->v.push_back(BlockSize + 10);
+    y.d->v.push_back(3.);
+    QCOMPARE(a.boundingRect(), QRectF(0, 0, BlockSize + 10, 3));
+    QVERIFY(a.sortedX());
+
+    x.d->v.push_back(-1.);
+    y.d->v.push_back(3.);
+    QCOMPARE(a.boundingRect(), QRectF(-1, 0, BlockSize + 11, 3));
+    QVERIFY(!a.sortedX());
+}
+
+void TestExtents::copiesKeepTheSource()
+{
+    QVector<double> y(2 * BlockSize, 0.);
+    y[7] = 5.;
+    DataSeriesAdaptor<QVector<double>> a(y);
+    const QRectF r = a.boundingRect();
+
+    std::unique_ptr<AbstractDataSeriesAdaptor> c(a.clone());
+    QVERIFY(c);
+    QCOMPARE(c->boundingRect(), r);
+    QCOMPARE(a.boundingRect(), r);
+
+    // a copy made before the first query scans on its own
+    DataSeriesAdaptor<QVector<double>> b(y);
+    std::unique_ptr<AbstractDataSeriesAdaptor> d(b.clone());
+    QCOMPARE(d->boundingRect(), r);
+    QCOMPARE(b.boundingRect(), r);
+}
+
+QTEST_MAIN(TestExtents)
+#include "tst_extents.moc"
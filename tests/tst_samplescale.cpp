@@ -0,0 +1,160 @@
+#include "adaptors_p.h"
+
+#include <QtTest>
+
+#include <limits>
+
+// Samples stored as float, qint32 or qint16, mapped by their scale and
+// offset (SampleScale) wherever they are read
+class TestSampleScale : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void mapping();
+    void int16Samples();
+    void int32Samples();
+    void floatSamples();
+    void negativeScale();
+    void mixedTypes();
+    void errorBars();
+    void autoscaledLimits();
+};
+
+namespace {
+
+// true if the memory published by a, read as the backend does, gives
+// the samples of sample()
+template <class A>
+bool viewMatches(const A &a, SeriesView::Type type)
+{
+    SeriesView v;
+    if (!a.view(v) || v.ytype != type || !uniformTypes(v))
+        return false;
+    return withSeriesView(v, [&](auto sample) {
+        for (int i = 0; i < a.size(); ++i)
+        {
+            if (sample(i) != a.sample(i))
+                return false;
+        }
+        return true;
+    });
+}
+
+} // namespace
+
+void TestSampleScale::mapping()
+{
+    const SampleScale identity;
+    QCOMPARE(identity(3.), 3.);
+    const SampleScale s{2., 1.};
+    QCOMPARE(s(3.), 7.);
+    QCOMPARE(s(-0.5), 0.);
+    const SampleScale flip{-1., 10.};
+    QCOMPARE(flip(4.), 6.);
+}
+
+void TestSampleScale::int16Samples()
+{
+    // ADC counts in volts
+    const qint16 lo = std::numeric_limits<qint16>::min();
+    const qint16 hi = std::numeric_limits<qint16>::max();
+    QVector<qint16> y{lo, 0, hi, 100};
+    DataSeriesAdaptor<QVector<qint16>> a(y);
+    a.yScale = SampleScale{1. / 32768., 0.};
+    QCOMPARE(a.sample(0), QPointF(0, -1));
+    QCOMPARE(a.sample(2), QPointF(2, hi / 32768.));
+    QCOMPARE(a.boundingRect(), QRectF(0, -1, 3, 1. + hi / 32768.));
+    QVERIFY(viewMatches(a, SeriesView::Int16));
+
+    // the x scale maps the sample index
+    a.xScale = SampleScale{0.5, 10.};
+    QCOMPARE(a.sample(3), QPointF(11.5, 100 / 32768.));
+    QCOMPARE(a.boundingRect().left(), 10.);
+    QCOMPARE(a.boundingRect().right(), 11.5);
+    QVERIFY(viewMatches(a, SeriesView::Int16));
+}
+
+void TestSampleScale::int32Samples()
+{
+    QVector<qint32> x{0, 1000, 2000}, y{-5, 7, 1};
+    DataSeriesAdaptor<QVector<qint32>> a(x, y);
+    a.xScale = SampleScale{1e-3, 0.};
+    a.yScale = SampleScale{0.25, 1.};
+    QCOMPARE(a.sample(1), QPointF(1, 2.75));
+    QCOMPARE(a.boundingRect(), QRectF(0, -0.25, 2, 3));
+    QVERIFY(a.sortedX());
+    QVERIFY(viewMatches(a, SeriesView::Int32));
+}
+
+void TestSampleScale::floatSamples()
+{
+    QVector<float> y{0.5f, -1.5f, 2.f};
+    DataSeriesAdaptor<QVector<float>> a(y);
+    QCOMPARE(a.sample(1), QPointF(1, -1.5));
+    QCOMPARE(a.boundingRect(), QRectF(0, -1.5, 2, 3.5));
+    a.yScale = SampleScale{2., -1.};
+    QCOMPARE(a.boundingRect(), QRectF(0, -4, 2, 7));
+    QVERIFY(viewMatches(a, SeriesView::Float));
+}
+
+void TestSampleScale::negativeScale()
+{
+    QVector<qint16> x{0, 1, 2}, y{1, 5, 3};
+    DataSeriesAdaptor<QVector<qint16>> a(x, y);
+    a.yScale = SampleScale{-2., 0.};
+    QCOMPARE(a.boundingRect(), QRectF(0, -10, 2, 8));
+    QVERIFY(a.sortedX());
+
+    // a reversed x axis is no longer sorted
+    a.xScale = SampleScale{-1., 0.};
+    QCOMPARE(a.boundingRect().left(), -2.);
+    QVERIFY(!a.sortedX());
+    QVERIFY(viewMatches(a, SeriesView::Int16));
+}
+
+void TestSampleScale::mixedTypes()
+{
+    // x and y of different types are read by sample()
+    const double x[] = {0., 1.};
+    const float y[] = {2.f, 3.f};
+    SeriesView v;
+    v.x = x;
+    v.y = y;
+    v.xtype = SeriesView::Double;
+    v.ytype = SeriesView::Float;
+    QVERIFY(!uniformTypes(v));
+    v.x = nullptr;
+    QVERIFY(uniformTypes(v));
+}
+
+void TestSampleScale::errorBars()
+{
+    QVector<qint16> y{100, 200}, e{10, 20};
+    ErrorBarAdaptor<QVector<qint16>> a(y, e);
+    a.yScale = SampleScale{0.01, 1.};
+    QCOMPARE(a.sample(1), QPointF(1, 3));
+    QCOMPARE(a.interval(0), QPointF(1.9, 2.1));
+    QCOMPARE(a.interval(1), QPointF(2.8, 3.2));
+    QCOMPARE(a.boundingRect(), QRectF(0, 2, 1, 1));
+    QCOMPARE(a.errorBoundingRect(), QRectF(0, 1.9, 1, 1.3));
+}
+
+void TestSampleScale::autoscaledLimits()
+{
+    // the axes follow the scaled values
+    QVector<qint16> y(1000);
+    for (int i = 0; i < y.size(); ++i)
+        y[i] = qint16(i * 30 - 15000);
+    QMatPlotWidget w;
+    PlotHandle h = w.plot(y.constData(), y.size());
+    QVERIFY(h.setYScale(1e-3, 100.));
+    w.replot();
+    w.replotNow();
+    const QPointF ylim = w.ylim();
+    QVERIFY(ylim.x() <= 85. && ylim.x() >= 70.);
+    QVERIFY(ylim.y() >= 114.97 && ylim.y() <= 130.);
+}
+
+QTEST_MAIN(TestSampleScale)
+#include "tst_samplescale.moc"
@@ -0,0 +1,204 @@
+#include "adaptors_p.h"
+
+#include <QtTest>
+#include <QThreadPool>
+
+#include <qwt_plot.h>
+
+#include <memory>
+#include <vector>
+
+// Runs of samples without NaN (SegmentIndex): runs split between the
+// parallel tasks are joined again, gaps never are
+class TestSegments : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void joinsAcrossTasks_data();
+    void joinsAcrossTasks();
+    void appends();
+    void adaptorGaps();
+    void drawsGaps_data();
+    void drawsGaps();
+
+private:
+    QThreadPool pool_;
+    int threshold_;
+};
+
+namespace {
+
+// 4 tasks of 4 blocks each, with bounds at 16384, 32768 and 49152
+const int Tasks = 4;
+const int N = Tasks * 4 * 4096;
+
+// runs of the samples [0, n) of gaps, found serially
+QVector<SeriesSegment> serialRuns(const std::vector<bool> &gaps, int n)
+{
+    QVector<SeriesSegment> runs;
+    appendSegments(0, n, [&](int i) { return bool(gaps[i]); }, runs);
+    return runs;
+}
+
+bool sameRuns(const QVector<SeriesSegment> &a, const QVector<SeriesSegment> &b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (int i = 0; i < a.size(); ++i)
+    {
+        if (a[i].from != b[i].from || a[i].to != b[i].to)
+            return false;
+    }
+    return true;
+}
+
+} // namespace
+
+void TestSegments::initTestCase()
+{
+    // fixed task bounds
+    pool_.setMaxThreadCount(Tasks);
+    QMatPlotWidget::setParallelPool(&pool_);
+    threshold_ = QMatPlotWidget::parallelThreshold();
+    QMatPlotWidget::setParallelThreshold(1);
+    QCOMPARE(parallelTasks(N, 4096), Tasks);
+}
+
+void TestSegments::cleanupTestCase()
+{
+    QMatPlotWidget::setParallelThreshold(threshold_);
+    QMatPlotWidget::setParallelPool(nullptr);
+}
+
+void TestSegments::joinsAcrossTasks_data()
+{
+    QTest::addColumn<QVector<int>>("gaps");
+    QTest::addColumn<int>("runs");
+    QTest::newRow("none") << QVector<int>() << 1;
+    QTest::newRow("all") << QVector<int>{-1} << 0;
+    QTest::newRow("at bound") << QVector<int>{16384} << 2;
+    QTest::newRow("before bound") << QVector<int>{16383} << 2;
+    QTest::newRow("across bound") << QVector<int>{32767, 32768} << 2;
+    QTest::newRow("every bound") << QVector<int>{16384, 32768, 49152} << 4;
+    QTest::newRow("ends") << QVector<int>{0, N - 1} << 1;
+    QTest::newRow("task start and end") << QVector<int>{16384, 32767} << 3;
+    QTest::newRow("single samples") << QVector<int>{16382, 16384, 16386} << 4;
+}
+
+void TestSegments::joinsAcrossTasks()
+{
+    QFETCH(QVector<int>, gaps);
+    QFETCH(int, runs);
+    std::vector<bool> gap(N, false);
+    for (int i : gaps)
+    {
+        if (i < 0)
+            gap.assign(N, true);
+        else
+            gap[i] = true;
+    }
+
+    SegmentIndex index;
+    const QVector<SeriesSegment> &r = index.segments(N, [&](int i) { return bool(gap[i]); });
+    QVERIFY(sameRuns(r, serialRuns(gap, N)));
+    QCOMPARE(r.size(), runs);
+}
+
+void TestSegments::appends()
+{
+    std::vector<bool> gap(N, false);
+    gap[100] = gap[20000] = true;
+    auto isGap = [&](int i) { return bool(gap[i]); };
+
+    // a run continued by the appended samples, then a gap at the end of
+    // the samples indexed before
+    SegmentIndex index;
+    index.segments(1000, isGap);
+    QVERIFY(sameRuns(index.segments(20000, isGap), serialRuns(gap, 20000)));
+    QVERIFY(sameRuns(index.segments(20001, isGap), serialRuns(gap, 20001)));
+    QVERIFY(sameRuns(index.segments(N, isGap), serialRuns(gap, N)));
+    QCOMPARE(index.segments(N, isGap).size(), 3);
+
+    // fewer samples, or invalidated: indexed again
+    gap[50] = true;
+    QVERIFY(sameRuns(index.segments(60, isGap), serialRuns(gap, 60)));
+    gap[30] = true;
+    index.invalidate();
+    QVERIFY(sameRuns(index.segments(N, isGap), serialRuns(gap, N)));
+}
+
+void TestSegments::adaptorGaps()
+{
+    const double nan = qQNaN();
+    QVector<double> x(N), y(N, 1.);
+    for (int i = 0; i < N; ++i)
+        x[i] = i;
+    x[16384] = nan;
+    y[40000] = nan;
+    DataSeriesAdaptor<QVector<double>> a(x, y);
+    const QVector<SeriesSegment> &r = a.cache()->segments(a);
+    QCOMPARE(r.size(), 3);
+    QCOMPARE(r[0].to, 16384);
+    QCOMPARE(r[1].from, 16385);
+    QCOMPARE(r[1].to, 40000);
+    QCOMPARE(r[2].from, 40001);
+    QCOMPARE(r[2].to, N);
+
+    // a copy for the render thread keeps the index
+    std::unique_ptr<AbstractDataSeriesAdaptor> c(a.clone());
+    const CachedSeriesAdaptor *cc = dynamic_cast<const CachedSeriesAdaptor *>(c.get());
+    QVERIFY(cc);
+    QVERIFY(sameRuns(cc->cache()->segments(*cc), r));
+}
+
+void TestSegments::drawsGaps_data()
+{
+    // as polylines, or decimated
+    QTest::addColumn<int>("n");
+    QTest::newRow("sparse") << 100;
+    QTest::newRow("dense") << 100000;
+}
+
+void TestSegments::drawsGaps()
+{
+    QFETCH(int, n);
+    QVector<double> y(n, 1.);
+    for (int i = 2 * n / 5; i < 3 * n / 5; ++i)
+        y[i] = qQNaN();
+
+    QMatPlotWidget w;
+    w.plot(y, "-", Qt::red);
+    w.setXlim(QPointF(0, n - 1));
+    w.setYlim(QPointF(0, 2));
+    w.resize(400, 300);
+    w.show();
+    QVERIFY(QTest::qWaitForWindowExposed(&w));
+    w.replot();
+    w.replotNow();
+    QwtPlot *plot = w.findChild<QwtPlot *>();
+    QVERIFY(plot);
+
+    // red on both sides of the gap, not in between
+    const QImage image = plot->canvas()->grab().toImage();
+    const int row = qRound(plot->transform(QwtPlot::yLeft, 1.));
+    auto red = [&](double x) {
+        const int col = qRound(plot->transform(QwtPlot::xBottom, x));
+        for (int j = row - 1; j <= row + 1; ++j)
+        {
+            const QColor c = image.pixelColor(col, j);
+            if (c.red() - c.green() > 60 && c.red() - c.blue() > 60)
+                return true;
+        }
+        return false;
+    };
+    QVERIFY(red(0.3 * n));
+    QVERIFY(red(0.7 * n));
+    for (int k = 42; k <= 58; ++k)
+        QVERIFY2(!red(k * 0.01 * n), qPrintable(QString("at %1%").arg(k)));
+}
+
+QTEST_MAIN(TestSegments)
+#include "tst_segments.moc"
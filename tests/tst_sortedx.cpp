@@ -0,0 +1,182 @@
+#include "adaptors_p.h"
+#include "sharedbuffer.h"
+
+#include <QtTest>
+
+#include <qwt_plot.h>
+
+// Detection of series sorted in x, and the clipping of sorted series
+// to the visible x range by binary search
+class TestSortedX : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void scan_data();
+    void scan();
+    void descentAtBounds_data();
+    void descentAtBounds();
+    void sampleIndex();
+    void scaledOrMarked();
+    void followsChanges();
+    void clipsToVisibleRange();
+
+private:
+    int threshold_;
+};
+
+void TestSortedX::initTestCase()
+{
+    // blocks scanned in parallel as well
+    threshold_ = QMatPlotWidget::parallelThreshold();
+    QMatPlotWidget::setParallelThreshold(2 * ExtentsCache::BlockSize);
+}
+
+void TestSortedX::cleanupTestCase()
+{
+    QMatPlotWidget::setParallelThreshold(threshold_);
+}
+
+void TestSortedX::scan_data()
+{
+    const double nan = qQNaN();
+    QTest::addColumn<QVector<double>>("x");
+    QTest::addColumn<bool>("sorted");
+    QTest::newRow("empty") << QVector<double>() << true;
+    QTest::newRow("single") << QVector<double>{1.} << true;
+    QTest::newRow("increasing") << QVector<double>{1., 2., 5.} << true;
+    QTest::newRow("repeated") << QVector<double>{1., 1., 2., 2.} << true;
+    QTest::newRow("descent") << QVector<double>{1., 3., 2.} << false;
+    QTest::newRow("decreasing") << QVector<double>{3., 2., 1.} << false;
+    QTest::newRow("nan") << QVector<double>{1., nan, 3.} << false;
+    QTest::newRow("first nan") << QVector<double>{nan, 2., 3.} << false;
+    QTest::newRow("last nan") << QVector<double>{1., 2., nan} << false;
+}
+
+void TestSortedX::scan()
+{
+    QFETCH(QVector<double>, x);
+    QFETCH(bool, sorted);
+    OrderedExtents e;
+    e.scanX(x, 0, x.size());
+    QCOMPARE(e.sorted, sorted);
+
+    DataSeriesAdaptor<QVector<double>> a(x, QVector<double>(x.size(), 0.));
+    QCOMPARE(a.sortedX(), sorted);
+}
+
+void TestSortedX::descentAtBounds_data()
+{
+    // the scan checks chunks of 1024 samples, the cache blocks of
+    // BlockSize samples, and the tasks several blocks each
+    const int block = ExtentsCache::BlockSize;
+    QTest::addColumn<int>("at");
+    QTest::newRow("first") << 1;
+    QTest::newRow("chunk") << 1024;
+    QTest::newRow("after chunk") << 1025;
+    QTest::newRow("block") << block;
+    QTest::newRow("task") << 4 * block;
+    QTest::newRow("last") << 8 * block - 1;
+}
+
+void TestSortedX::descentAtBounds()
+{
+    QFETCH(int, at);
+    const int n = 8 * ExtentsCache::BlockSize;
+    QVector<double> x(n), y(n, 0.);
+    for (int i = 0; i < n; ++i)
+        x[i] = i;
+    DataSeriesAdaptor<QVector<double>> sorted(x, y);
+    QVERIFY(sorted.sortedX());
+
+    // x[at] < x[at - 1]
+    x[at] = at - 1.5;
+    DataSeriesAdaptor<QVector<double>> a(x, y);
+    QVERIFY(!a.sortedX());
+    QCOMPARE(a.boundingRect().left(), at == 1 ? -0.5 : 0.);
+}
+
+void TestSortedX::sampleIndex()
+{
+    // x is the sample index
+    DataSeriesAdaptor<QVector<double>> a(QVector<double>{3., 1., 2.});
+    QVERIFY(a.sortedX());
+    StairsAdaptor<QVector<double>> s(QVector<double>{3., 1., 2.});
+    QVERIFY(s.sortedX());
+}
+
+void TestSortedX::scaledOrMarked()
+{
+    DataSeriesAdaptor<QVector<double>> a(QVector<double>{1., 2.}, QVector<double>{0., 0.});
+    QVERIFY(a.sortedX());
+    a.xScale.scale = -1.;
+    QVERIFY(!a.sortedX());
+    a.xScale.scale = 2.;
+    QVERIFY(a.sortedX());
+
+    // marked by the caller, see PlotHandle::setSortedX()
+    DataSeriesAdaptor<QVector<double>> b(QVector<double>{2., 1.}, QVector<double>{0., 0.});
+    QVERIFY(!b.sortedX());
+    b.xSorted = true;
+    QVERIFY(b.sortedX());
+}
+
+void TestSortedX::followsChanges()
+{
+    SharedBuffer x{0., 1., 2., 3.}, y{0., 0., 0., 0.};
+    DataSeriesAdaptor<SharedBuffer> a(x, y);
+    QVERIFY(a.sortedX());
+    x.set(2, 0.5);
+    QVERIFY(!a.sortedX());
+    x.set(2, 1.5);
+    QVERIFY(a.sortedX());
+
+    // an appended sample is checked against the last one
+    x.d->v.push_back(3.);
+    y.d->v.push_back(0.);
+    QVERIFY(a.sortedX());
+    x.d->v.push_back(2.);
+    y.d->v.push_back(0.);
+    QVERIFY(!a.sortedX());
+}
+
+void TestSortedX::clipsToVisibleRange()
+{
+    const int n = 100000;
+    QVector<double> x(n), y(n);
+    for (int i = 0; i < n; ++i)
+    {
+        x[i] = i;
+        y[i] = i % 10;
+    }
+
+    QMatPlotWidget w;
+    w.plot(x, y);
+    w.setXlim(QPointF(50000, 50999));
+    w.setYlim(QPointF(0, 10));
+    w.resize(400, 300);
+    w.show();
+    QVERIFY(QTest::qWaitForWindowExposed(&w));
+    w.replot();
+    w.replotNow();
+
+    // the visible samples and their neighbors, within a few pixels
+    quint64 submitted = w.renderStats().pointsSubmitted;
+    QVERIFY(submitted >= 1000);
+    QVERIFY(submitted <= 1100);
+
+    // unsorted: all samples are submitted
+    std::swap(x[10], x[11]);
+    w.clear();
+    w.plot(x, y);
+    w.setXlim(QPointF(50000, 50999));
+    w.setYlim(QPointF(0, 10));
+    w.replot();
+    w.replotNow();
+    QCOMPARE(w.renderStats().pointsSubmitted, quint64(n));
+}
+
+QTEST_MAIN(TestSortedX)
+#include "tst_sortedx.moc"
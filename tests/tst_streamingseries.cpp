@@ -0,0 +1,248 @@
+#include "qmatplotwidget_p.h"
+
+#include <QtTest>
+
+#include <thread>
+#include <vector>
+
+// The queue and the history rings of StreamingSeries, across their
+// wraparound
+class TestStreamingSeries : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void queueWrapsAround();
+    void fullQueueDrops();
+    void historyWrapsAround();
+    void extentsForgetOverwritten();
+    void sortedAfterOverwrite();
+    void segmentsAfterOverwrite();
+    void concurrentProducer();
+};
+
+namespace {
+
+// append x = from, ..., from + n - 1 and y = -x
+int appendRange(StreamingSeries &s, int from, int n)
+{
+    std::vector<double> x(n), y(n);
+    for (int i = 0; i < n; ++i)
+    {
+        x[i] = from + i;
+        y[i] = -x[i];
+    }
+    return s.append(x.data(), y.data(), n);
+}
+
+// true if the history holds x = last - size() + 1, ..., last in order
+bool holdsUpTo(const StreamingSeries &s, int last)
+{
+    const int n = s.size();
+    std::vector<double> x(n), y(n);
+    s.copy(x.data(), y.data());
+    for (int i = 0; i < n; ++i)
+    {
+        const double v = last - n + 1 + i;
+        if (x[i] != v || y[i] != -v || s.sample(i) != QPointF(v, -v))
+            return false;
+    }
+    return true;
+}
+
+} // namespace
+
+void TestStreamingSeries::queueWrapsAround()
+{
+    // the queue has room for 65536 samples: wrap around it a few times
+    StreamingSeries s(1000);
+    int next = 0;
+    for (int k = 0; k < 300; ++k)
+    {
+        QCOMPARE(appendRange(s, next, 777), 777);
+        next += 777;
+        QCOMPARE(s.drain(), 777);
+        QVERIFY(holdsUpTo(s, next - 1));
+    }
+    QCOMPARE(s.size(), 1000);
+    QCOMPARE(s.dropped(), quint64(0));
+    QCOMPARE(s.version(), quint64(next));
+}
+
+void TestStreamingSeries::fullQueueDrops()
+{
+    StreamingSeries s(100);
+    const int room = 65536;
+    QCOMPARE(appendRange(s, 0, room - 10), room - 10);
+    QCOMPARE(appendRange(s, room - 10, 50), 10);
+    QCOMPARE(s.dropped(), quint64(40));
+
+    // the last capacity samples accepted
+    QCOMPARE(s.drain(), room);
+    QCOMPARE(s.size(), 100);
+    QVERIFY(holdsUpTo(s, room - 1));
+
+    // room again after the drain
+    QCOMPARE(appendRange(s, room, 50), 50);
+    QCOMPARE(s.drain(), 50);
+    QVERIFY(holdsUpTo(s, room + 49));
+    QCOMPARE(s.dropped(), quint64(40));
+}
+
+void TestStreamingSeries::historyWrapsAround()
+{
+    StreamingSeries s(10);
+    SeriesView a, b, v;
+    appendRange(s, 0, 7);
+    s.drain();
+    s.views(a, b);
+    QCOMPARE(a.size, 7);
+    QCOMPARE(b.size, 0);
+    QVERIFY(s.view(v));
+    QCOMPARE(v.size, 7);
+
+    // 3 samples fill the ring, 4 overwrite the oldest
+    appendRange(s, 7, 7);
+    s.drain();
+    QCOMPARE(s.size(), 10);
+    QVERIFY(holdsUpTo(s, 13));
+    s.views(a, b);
+    QCOMPARE(a.size, 6);
+    QCOMPARE(b.size, 4);
+    QCOMPARE(static_cast<const double *>(a.x)[0], 4.);
+    QCOMPARE(static_cast<const double *>(a.y)[5], -9.);
+    QCOMPARE(static_cast<const double *>(b.x)[0], 10.);
+    QCOMPARE(static_cast<const double *>(b.y)[3], -13.);
+    // no longer contiguous in index order
+    QVERIFY(!s.view(v));
+
+    // back to the start of the ring
+    appendRange(s, 14, 6);
+    s.drain();
+    QVERIFY(holdsUpTo(s, 19));
+    s.views(a, b);
+    QCOMPARE(a.size, 10);
+    QCOMPARE(b.size, 0);
+    QVERIFY(s.view(v));
+}
+
+void TestStreamingSeries::extentsForgetOverwritten()
+{
+    StreamingSeries s(8);
+    appendRange(s, 0, 5);
+    s.drain();
+    QCOMPARE(s.boundingRect(), QRectF(0, -4, 4, 4));
+
+    // more than a ring of samples in one drain, then a partial one
+    // overwriting across the end of the ring
+    appendRange(s, 5, 20);
+    s.drain();
+    QCOMPARE(s.boundingRect(), QRectF(17, -24, 7, 7));
+    appendRange(s, 25, 5);
+    s.drain();
+    QCOMPARE(s.boundingRect(), QRectF(22, -29, 7, 7));
+
+    // an outlier is forgotten once overwritten
+    const double x = 30., y = 1000.;
+    s.append(&x, &y, 1);
+    s.drain();
+    QCOMPARE(s.boundingRect().bottom(), 1000.);
+    appendRange(s, 31, 8);
+    s.drain();
+    QCOMPARE(s.boundingRect(), QRectF(31, -38, 7, 7));
+}
+
+void TestStreamingSeries::sortedAfterOverwrite()
+{
+    StreamingSeries s(5);
+    appendRange(s, 0, 5);
+    s.drain();
+    QVERIFY(s.sortedX());
+
+    // a step back in x, until the samples before it are overwritten
+    appendRange(s, 2, 3);
+    s.drain();
+    QVERIFY(!s.sortedX());
+    appendRange(s, 5, 1);
+    s.drain();
+    QVERIFY(!s.sortedX());
+    appendRange(s, 6, 1);
+    s.drain();
+    QVERIFY(s.sortedX());
+
+    // a NaN x is out of order too
+    const double nan = qQNaN(), y = 0.;
+    s.append(&nan, &y, 1);
+    s.drain();
+    QVERIFY(!s.sortedX());
+    appendRange(s, 20, 5);
+    s.drain();
+    QVERIFY(s.sortedX());
+}
+
+void TestStreamingSeries::segmentsAfterOverwrite()
+{
+    StreamingSeries s(4);
+    QVector<SeriesSegment> runs;
+    appendRange(s, 0, 4);
+    s.drain();
+    QVERIFY(s.segments(runs));
+    QCOMPARE(runs.size(), 1);
+    QCOMPARE(runs[0].to, 4);
+
+    // a NaN y leaves the gaps to the backend until overwritten
+    const double x = 4., nan = qQNaN();
+    s.append(&x, &nan, 1);
+    s.drain();
+    QVERIFY(!s.segments(runs));
+    appendRange(s, 5, 4);
+    s.drain();
+    QVERIFY(s.segments(runs));
+    QCOMPARE(runs.size(), 1);
+}
+
+void TestStreamingSeries::concurrentProducer()
+{
+    const int batch = 1000, total = 2000 * batch;
+    StreamingSeries s(10000);
+    int accepted = 0;
+    std::thread producer([&]() {
+        std::vector<double> x(batch), y(batch);
+        for (int i = 0; i < total; i += batch)
+        {
+            for (int k = 0; k < batch; ++k)
+                y[k] = -(x[k] = i + k);
+            accepted += s.append(x.data(), y.data(), batch);
+        }
+    });
+
+    // each drain sees whole samples, in increasing order; the samples
+    // not accepted when the queue is full are counted as dropped
+    double last = -1.;
+    quint64 drained = 0;
+    bool ok = true;
+    auto check = [&]() {
+        drained += s.drain();
+        std::vector<double> x(s.size()), y(s.size());
+        s.copy(x.data(), y.data());
+        for (size_t i = 0; i < x.size(); ++i)
+            ok = ok && y[i] == -x[i] && (i == 0 || x[i] > x[i - 1]);
+        if (!x.empty())
+        {
+            ok = ok && x.back() >= last;
+            last = x.back();
+        }
+    };
+    while (s.version() + s.dropped() < quint64(total))
+        check();
+    producer.join();
+    check();
+
+    QVERIFY(ok);
+    QCOMPARE(drained, quint64(accepted));
+    QCOMPARE(quint64(accepted) + s.dropped(), quint64(total));
+    QCOMPARE(s.size(), 10000);
+}
+
+QTEST_MAIN(TestStreamingSeries)
+#include "tst_streamingseries.moc"
@@ -0,0 +1,145 @@
+#include <QMatPlotWidget>
+
+#include <QtTest>
+
+#include <qwt_plot.h>
+
+// Frames rendered in the render thread: while one is rendered, the next
+// waits in a single slot, where a newer frame replaces it
+class TestThreadedRendering : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void latestFrameWins();
+    void rendersFrameInFlight();
+    void nonOwningDataOnGuiThread();
+};
+
+// render the pending changes and wait until no more frames are shown
+static void settle(QMatPlotWidget &w)
+{
+    QSignalSpy spy(&w, &QMatPlotWidget::frameRendered);
+    w.replot();
+    w.replotNow();
+    while (spy.wait(200))
+        ;
+}
+
+// show w with its first frame, return its plot
+static QwtPlot *showPlot(QMatPlotWidget &w)
+{
+    w.resize(400, 300);
+    w.show();
+    if (!QTest::qWaitForWindowExposed(&w))
+        return nullptr;
+    settle(w);
+    return w.findChild<QwtPlot *>();
+}
+
+// row of the canvas with the most reddish pixels
+static int redRow(QwtPlot *plot)
+{
+    const QImage image = plot->canvas()->grab().toImage();
+    int row = -1, most = 0;
+    for (int j = 0; j < image.height(); ++j)
+    {
+        int n = 0;
+        for (int i = 0; i < image.width(); ++i)
+        {
+            const QColor c = image.pixelColor(i, j);
+            if (c.red() - c.green() > 60 && c.red() - c.blue() > 60)
+                ++n;
+        }
+        if (n > most)
+        {
+            most = n;
+            row = j;
+        }
+    }
+    return row;
+}
+
+void TestThreadedRendering::latestFrameWins()
+{
+    const int frames = 10;
+    QMatPlotWidget w;
+    w.setThreadedRendering(true);
+    PlotHandle h = w.plot(QVector<double>(2, 0.), "-", Qt::red);
+    w.setXlim(QPointF(0, 1));
+    w.setYlim(QPointF(0, frames + 1));
+    QwtPlot *plot = showPlot(w);
+    QVERIFY(plot);
+
+    // the events are not processed meanwhile, so the first frame is
+    // still in flight when the others are submitted: each of them
+    // replaces the one before in the slot
+    const quint64 shown = w.frameCount(), dropped = w.droppedFrames();
+    QSignalSpy spy(&w, &QMatPlotWidget::frameRendered);
+    for (int k = 1; k <= frames; ++k)
+    {
+        QVERIFY(h.setYData(QVector<double>(2, k)));
+        w.replot();
+        w.replotNow();
+    }
+    QCOMPARE(w.droppedFrames() - dropped, quint64(frames - 2));
+    QCOMPARE(spy.count(), 0);
+
+    // the first and the last frame are shown
+    while (spy.wait(200))
+        ;
+    QCOMPARE(spy.count(), 2);
+    QCOMPARE(w.frameCount() - shown, quint64(2));
+    QCOMPARE(w.renderStats().framesDropped, w.droppedFrames());
+    const int row = redRow(plot);
+    QVERIFY(qAbs(row - qRound(plot->transform(QwtPlot::yLeft, frames))) <= 1);
+}
+
+void TestThreadedRendering::rendersFrameInFlight()
+{
+    // a single frame submitted while idle is never dropped
+    QMatPlotWidget w;
+    w.setThreadedRendering(true);
+    PlotHandle h = w.plot(QVector<double>(2, 0.), "-", Qt::red);
+    w.setXlim(QPointF(0, 1));
+    w.setYlim(QPointF(0, 4));
+    QwtPlot *plot = showPlot(w);
+    QVERIFY(plot);
+
+    const quint64 shown = w.frameCount(), dropped = w.droppedFrames();
+    for (int k = 1; k <= 3; ++k)
+    {
+        QVERIFY(h.setYData(QVector<double>(2, k)));
+        settle(w);
+        QCOMPARE(w.frameCount() - shown, quint64(k));
+        QCOMPARE(w.droppedFrames(), dropped);
+        const int row = redRow(plot);
+        QVERIFY(qAbs(row - qRound(plot->transform(QwtPlot::yLeft, k))) <= 1);
+    }
+}
+
+void TestThreadedRendering::nonOwningDataOnGuiThread()
+{
+    // views of the caller's memory cannot be copied for the render
+    // thread: their frames are rendered at once, on the GUI thread
+    QVector<double> y(2, 1.);
+    QMatPlotWidget w;
+    w.setThreadedRendering(true);
+    w.plot(y.constData(), y.size(), "-", Qt::red);
+    w.setXlim(QPointF(0, 1));
+    w.setYlim(QPointF(0, 4));
+    QwtPlot *plot = showPlot(w);
+    QVERIFY(plot);
+
+    const quint64 shown = w.frameCount();
+    y.fill(2.);
+    w.dataChanged();
+    w.replot();
+    w.replotNow();
+    QCOMPARE(w.frameCount() - shown, quint64(1));
+    const int row = redRow(plot);
+    QVERIFY(qAbs(row - qRound(plot->transform(QwtPlot::yLeft, 2.))) <= 1);
+}
+
+QTEST_MAIN(TestThreadedRendering)
+#include "tst_threadedrendering.moc"
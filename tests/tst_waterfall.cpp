@@ -0,0 +1,128 @@
+#include <QMatPlotWidget>
+
+#include <QtTest>
+
+#include <qwt_plot.h>
+
+// Rows of a waterfall plot: the newest at the top, older rows scrolling
+// down as the ring of rows wraps around
+class TestWaterfall : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void rowsScroll_data();
+    void rowsScroll();
+    void checksRowLength();
+};
+
+namespace {
+
+const int Columns = 2;
+const int Depth = 4;
+// color of the values n + 0.5, over a clim of [0, 3]
+const QRgb Colors[] = {qRgb(255, 0, 0), qRgb(0, 255, 0), qRgb(0, 0, 255)};
+
+// value of column c of the k-th row appended
+double value(int k, int c)
+{
+    return (k + c) % 3 + 0.5;
+}
+
+} // namespace
+
+// render the pending changes and wait until the frame is shown
+static bool renderFrame(QMatPlotWidget &w)
+{
+    QSignalSpy spy(&w, &QMatPlotWidget::frameRendered);
+    w.replot();
+    w.replotNow();
+    // a threaded frame in flight may be shown before this one
+    while (w.threadedRendering() && spy.wait(200))
+        ;
+    return spy.count() > 0;
+}
+
+// true if the canvas shows the last min(n, Depth) of the n rows
+// appended, newest first, and nothing below them
+static bool showsRows(QwtPlot *plot, int n)
+{
+    const QImage image = plot->canvas()->grab().toImage();
+    for (int r = 0; r < Depth; ++r)
+    {
+        for (int c = 0; c < Columns; ++c)
+        {
+            const int x = qRound(plot->transform(QwtPlot::xBottom, c + 0.5));
+            const int y = qRound(plot->transform(QwtPlot::yLeft, Depth - r - 0.5));
+            const QColor color(image.pixel(x, y));
+            if (r < n)
+            {
+                if (color != QColor(Colors[(n - 1 - r + c) % 3]))
+                    return false;
+            }
+            else
+            {
+                for (QRgb empty : Colors)
+                    if (color == QColor(empty))
+                        return false;
+            }
+        }
+    }
+    return true;
+}
+
+void TestWaterfall::rowsScroll_data()
+{
+    QTest::addColumn<bool>("threaded");
+    QTest::newRow("gui thread") << false;
+    QTest::newRow("render thread") << true;
+}
+
+void TestWaterfall::rowsScroll()
+{
+    QFETCH(bool, threaded);
+
+    QMatPlotWidget w;
+    w.setThreadedRendering(threaded);
+    w.setColorMap(QVector<QRgb>{Colors[0], Colors[1], Colors[2]});
+    PlotHandle h = w.waterfall(Columns, Depth, QPointF(0, 3));
+    w.setXlim(QPointF(0, Columns));
+    w.setYlim(QPointF(0, Depth));
+    w.resize(400, 300);
+    w.show();
+    QVERIFY(QTest::qWaitForWindowExposed(&w));
+    QwtPlot *plot = w.findChild<QwtPlot *>();
+    QVERIFY(plot);
+
+    // single rows, then several per frame: the render thread copies
+    // only the rows appended since its last frame, or all of them
+    int n = 0;
+    for (int step : {1, 1, 1, 1, 1, 2, 3, 5, 1, 4})
+    {
+        for (int k = 0; k < step; ++k, ++n)
+        {
+            QVector<double> row(Columns);
+            for (int c = 0; c < Columns; ++c)
+                row[c] = value(n, c);
+            QVERIFY(h.appendRow(row));
+        }
+        QVERIFY(renderFrame(w));
+        QVERIFY2(showsRows(plot, n), qPrintable(QString("after %1 rows").arg(n)));
+    }
+}
+
+void TestWaterfall::checksRowLength()
+{
+    QMatPlotWidget w;
+    PlotHandle h = w.waterfall(Columns, Depth, QPointF(0, 3));
+    QVERIFY(!h.appendRow(QVector<double>(Columns + 1)));
+    QVERIFY(!h.appendRow(QVector<double>()));
+    QVERIFY(h.appendRow(QVector<double>(Columns, 1.)));
+
+    // only waterfalls take rows
+    PlotHandle p = w.plot(QVector<double>(3, 1.));
+    QVERIFY(!p.appendRow(QVector<double>(Columns, 1.)));
+}
+
+QTEST_MAIN(TestWaterfall)
+#include "tst_waterfall.moc"